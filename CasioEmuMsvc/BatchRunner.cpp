@@ -0,0 +1,328 @@
+﻿#include "BatchRunner.hpp"
+
+#include "BootCache.hpp"
+#include "Chipset/Chipset.hpp"
+#include "Chipset/MMU.hpp"
+#include "Containers/WorkStealingPool.h"
+#include "Emulator.hpp"
+#include "HeadlessRunner.hpp"
+#include "Logger.hpp"
+#include "ModelInfo.h"
+#include "Models.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace casioemu {
+	namespace {
+		struct BatchJob {
+			size_t line;
+			std::string name;
+			std::map<std::string, std::string> args;
+			std::vector<std::string> keys;
+			std::vector<uint8_t> inject;
+			std::string input;
+			double boot_seconds = 1, run_seconds = 1;
+		};
+
+		struct BatchResult {
+			bool ok = false;
+			std::string error;
+			uint64_t screen_hash = 0;
+			double emulated_seconds = 0, wall_seconds = 0;
+			uint64_t instructions = 0;
+		};
+
+		std::vector<std::string> SplitArguments(const std::string& line) {
+			std::vector<std::string> tokens;
+			std::string token;
+			bool quoted = false, any = false;
+			for (char c : line) {
+				if (c == '"') {
+					quoted = !quoted;
+					any = true;
+				}
+				else if (!quoted && (c == ' ' || c == '\t' || c == '\r')) {
+					if (any)
+						tokens.push_back(std::move(token));
+					token.clear();
+					any = false;
+				}
+				else {
+					token += c;
+					any = true;
+				}
+			}
+			if (any)
+				tokens.push_back(std::move(token));
+			return tokens;
+		}
+
+		void ParseJob(const std::string& line, size_t line_number, BatchJob& job) {
+			job.line = line_number;
+			job.name = std::to_string(line_number);
+			for (auto& token : SplitArguments(line)) {
+				auto eq_pos = token.find('=');
+				std::string key = token.substr(0, eq_pos), value = eq_pos == std::string::npos ? "" : token.substr(eq_pos + 1);
+				if (key == "name")
+					job.name = value;
+				else if (key == "keys") {
+					std::istringstream iss(value);
+					std::string name;
+					while (std::getline(iss, name, ','))
+						if (!name.empty())
+							job.keys.push_back(name);
+				}
+				else if (key == "inject") {
+					for (size_t i = 0; i + 1 < value.size(); i += 2)
+						job.inject.push_back((uint8_t)std::strtoul(value.substr(i, 2).c_str(), nullptr, 16));
+				}
+				else if (key == "input")
+					job.input = value;
+				else if (key == "boot")
+					job.boot_seconds = std::atof(value.c_str()) / 1000;
+				else if (key == "run")
+					job.run_seconds = std::atof(value.c_str()) / 1000;
+				else
+					job.args[key] = value;
+			}
+			job.args["headless"];
+			job.args["turbo"];
+			// Nobody rewinds a job, don't spend memory on checkpoints for each worker.
+			job.args["rewind"] = "0";
+			// Jobs share RAM images, never write them back.
+			if (job.args.find("ram") != job.args.end())
+				job.args["preserve_ram"];
+		}
+
+		/**
+		 * The emulator PANICs on a model it can't load, which would take the whole batch down, so
+		 * the files a job needs are checked first. Returns false with `error` set if one is missing.
+		 */
+		bool CheckJob(BatchJob& job, std::string& error) {
+			namespace fs = std::filesystem;
+			auto exists = [&](const fs::path& path, const char* what) {
+				std::error_code ec;
+				if (fs::is_regular_file(path, ec))
+					return true;
+				error = std::string("cannot open ") + what + " " + path.string();
+				return false;
+			};
+			if (job.args["model"].empty()) {
+				error = "no model";
+				return false;
+			}
+			fs::path model = job.args["model"];
+			if (!exists(model / "config.bin", "model config"))
+				return false;
+			ModelInfo modeldef{};
+			try {
+				std::ifstream config(model / "config.bin", std::ios::in | std::ios::binary);
+				modeldef.Read(config);
+				if (!config)
+					throw std::runtime_error("cut short");
+			}
+			catch (std::exception const&) {
+				error = "damaged model config " + (model / "config.bin").string();
+				return false;
+			}
+			if (modeldef.hardware_id < HW_MIN || modeldef.hardware_id > HW_MAX) {
+				error = "unknown hardware id " + std::to_string(modeldef.hardware_id);
+				return false;
+			}
+			if (!exists(model / modeldef.interface_path, "interface image") || !exists(model / modeldef.rom_path, "ROM"))
+				return false;
+			if (modeldef.hardware_id == HW_FX_5800P && !exists(model / modeldef.flash_path, "flash"))
+				return false;
+			auto ram = job.args.find("ram");
+			if (ram != job.args.end() && job.args.find("clean_ram") == job.args.end() && !exists(ram->second, "RAM image"))
+				return false;
+			return job.input.empty() || exists(job.input, "input");
+		}
+
+		uint64_t HashPixels(const std::vector<uint32_t>& pixels, int width, int height) {
+			// FNV-1a
+			uint64_t hash = 0xcbf29ce484222325;
+			auto mix = [&](uint32_t v) {
+				for (int i = 0; i != 4; ++i, v >>= 8) {
+					hash ^= v & 0xFF;
+					hash *= 0x100000001b3;
+				}
+			};
+			mix(width);
+			mix(height);
+			for (auto pixel : pixels)
+				mix(pixel);
+			return hash;
+		}
+
+		BatchResult RunJob(BatchJob& job) {
+			BatchResult result;
+			auto start = std::chrono::steady_clock::now();
+			if (!CheckJob(job, result.error))
+				return result;
+			{
+				// Paused until the runner waits, so every job sees the same ticks between its inputs.
+				Emulator emulator(job.args, true);
+				HeadlessRunner runner(emulator);
+				result.ok = true;
+				if (!emulator.booted_from_cache) {
+					runner.WaitEmulated(job.boot_seconds);
+					// Let a first boot reach the idle state and be cached before the job touches it.
+					for (int i = 0; i != 100 && emulator.boot_cache && emulator.boot_cache->Pending(); ++i)
+						runner.WaitEmulated(0.1);
+					// Start the job from the captured state itself, as a cache hit would.
+					if (emulator.boot_cache)
+						emulator.Call([&] { return emulator.boot_cache->RestoreCaptured(); }).get();
+				}
+				if (!job.inject.empty()) {
+					emulator.Call([&] {
+						auto base = GetInputAreaOffset(emulator.hardware_id);
+						for (size_t i = 0; i != job.inject.size(); ++i)
+							emulator.chipset.mmu.WriteData(base + i, job.inject[i]);
+					}).get();
+				}
+				for (auto& key : job.keys) {
+					if (!runner.Execute("key " + key)) {
+						result.ok = false;
+						result.error = "no button bound to key " + key;
+						break;
+					}
+				}
+				if (result.ok && !job.input.empty()) {
+					std::ifstream script(job.input);
+					if (!script) {
+						result.ok = false;
+						result.error = "cannot open " + job.input;
+					}
+					std::string line;
+					while (result.ok && std::getline(script, line)) {
+						// `quit` would shut the emulator down under the job, it only ends the script here.
+						std::string command;
+						std::istringstream(line) >> command;
+						if (command == "quit")
+							break;
+						if (!runner.Execute(line)) {
+							result.ok = false;
+							result.error = "script command failed: " + line;
+						}
+					}
+				}
+				if (result.ok)
+					runner.WaitEmulated(job.run_seconds);
+
+				std::vector<uint32_t> pixels;
+				int width = 0, height = 0;
+				if (runner.ReadScreen(pixels, width, height))
+					result.screen_hash = HashPixels(pixels, width, height);
+				emulator.Query([&] {
+					result.emulated_seconds = emulator.GetEmulatedSeconds();
+					result.instructions = emulator.chipset.instructions_executed;
+				}).get();
+				emulator.Shutdown();
+			}
+			result.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			return result;
+		}
+
+		std::string JsonString(const std::string& s) {
+			std::string out = "\"";
+			for (char c : s) {
+				if (c == '"' || c == '\\') {
+					out += '\\';
+					out += c;
+				}
+				else if ((unsigned char)c < 0x20) {
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04x", c);
+					out += buf;
+				}
+				else
+					out += c;
+			}
+			return out + "\"";
+		}
+	} // namespace
+
+	int BatchRun(std::map<std::string, std::string>& argv_map) {
+		std::ifstream list(argv_map["batch"]);
+		if (!list)
+			PANIC("Cannot open batch job list '%s'\n", argv_map["batch"].c_str());
+
+		std::vector<BatchJob> jobs;
+		std::string line;
+		size_t line_number = 0;
+		while (std::getline(list, line)) {
+			++line_number;
+			auto first = line.find_first_not_of(" \t\r");
+			if (first == std::string::npos || line[first] == '#')
+				continue;
+			BatchJob job;
+			ParseJob(line, line_number, job);
+			// A batch-wide boot cache, jobs may still name their own.
+			auto boot_cache = argv_map.find("boot_cache");
+			if (boot_cache != argv_map.end() && job.args.find("boot_cache") == job.args.end())
+				job.args["boot_cache"] = boot_cache->second;
+			jobs.push_back(std::move(job));
+		}
+
+		auto output_path = argv_map.find("batch_output");
+		std::ofstream output(output_path == argv_map.end() ? "batch_results.jsonl" : output_path->second);
+		if (!output)
+			PANIC("Cannot create batch output\n");
+
+		size_t thread_count = std::thread::hardware_concurrency();
+		auto threads = argv_map.find("batch_threads");
+		if (threads != argv_map.end())
+			thread_count = std::strtoul(threads->second.c_str(), nullptr, 10);
+
+		bool verify = argv_map.find("batch_verify") != argv_map.end();
+		std::mutex output_mutex;
+		size_t failed = 0;
+		auto start = std::chrono::steady_clock::now();
+		{
+			WorkStealingPool pool(thread_count);
+			logger::Info("[Batch][Info] %zu jobs on %zu threads\n", jobs.size(), pool.Size());
+			for (auto& job : jobs) {
+				pool.Submit([&] {
+					auto result = RunJob(job);
+					if (verify && result.ok) {
+						auto again = RunJob(job);
+						if (!again.ok) {
+							result.ok = false;
+							result.error = "second run failed: " + again.error;
+						}
+						else if (again.screen_hash != result.screen_hash || again.instructions != result.instructions) {
+							result.ok = false;
+							result.error = "second run differs";
+						}
+					}
+					char hash[17];
+					snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)result.screen_hash);
+					std::ostringstream record;
+					record << "{\"name\":" << JsonString(job.name) << ",\"line\":" << job.line
+						   << ",\"status\":\"" << (result.ok ? "ok" : "failed") << "\"";
+					if (!result.ok)
+						record << ",\"error\":" << JsonString(result.error);
+					record << ",\"screen_hash\":\"" << hash << "\",\"emulated_seconds\":" << result.emulated_seconds
+						   << ",\"wall_seconds\":" << result.wall_seconds << ",\"instructions\":" << result.instructions << "}\n";
+					std::lock_guard<std::mutex> lock(output_mutex);
+					output << record.str() << std::flush;
+					if (!result.ok)
+						++failed;
+				});
+			}
+			pool.Wait();
+		}
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		logger::Info("[Batch][Info] %zu jobs done in %.2f s, %zu failed\n", jobs.size(), elapsed, failed);
+		return failed ? 1 : 0;
+	}
+} // namespace casioemu
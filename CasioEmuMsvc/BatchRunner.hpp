@@ -0,0 +1,34 @@
+﻿#pragma once
+#include "Config.hpp"
+
+#include <map>
+#include <string>
+
+namespace casioemu {
+	/**
+	 * Runs the calculator sessions listed in the file given by the `batch` argument on a
+	 * work-stealing pool of `batch_threads` threads (one per host core by default), each one a
+	 * headless, turbo emulator of its own. One job per line, written like command line arguments:
+	 *
+	 *   name=<id>          shows up in the results, the line number by default
+	 *   model=<dir>        required
+	 *   ram=<file>         RAM image to start from, left unchanged
+	 *   inject=<hex>       bytes written to the input area after booting
+	 *   keys=<k1,k2,...>   host key names pressed one after another
+	 *   input=<file>       HeadlessRunner script run after the keys, `quit` ends it
+	 *   boot=<ms>          emulated time before any input, 1000 by default, none when the boot
+	 *                      state comes from the boot cache (see BootCache)
+	 *   run=<ms>           emulated time after the input, the stop condition, 1000 by default
+	 *
+	 * Values may be double quoted, anything else is passed on to the emulator as an argument.
+	 * A `boot_cache` given to the batch itself applies to every job. Jobs are deterministic: they
+	 * start paused, run for exact tick counts and fill power-on RAM from a fixed `seed`. With
+	 * `batch_verify` every job runs twice and fails if the second run fails or ends on another
+	 * screen or instruction count.
+	 * Results go to `batch_output` (batch_results.jsonl by default), one JSON object per job with
+	 * the status, a hash of the final screen and timings. A job without a model, or whose model,
+	 * ROM or input files are missing, fails on its own with the reason, the others still run.
+	 * Returns the process exit code, 1 if any job failed.
+	 */
+	int BatchRun(std::map<std::string, std::string>& argv_map);
+} // namespace casioemu
@@ -99,6 +99,17 @@ public:
 	static void Read(std::istream& stm, BinaryClass auto& cls) {
 		cls.Read(stm);
 	}
+	/// <summary>
+	/// 依次读写多个值
+	/// </summary>
+	template <class... T>
+	static void WriteAll(std::ostream& stm, const T&... dat) {
+		(Write(stm, dat), ...);
+	}
+	template <class... T>
+	static void ReadAll(std::istream& stm, T&... dat) {
+		(Read(stm, dat), ...);
+	}
 	static void Read(std::istream& stm, BinaryVector auto& vec) {
 		using ContainerChild = ::ContainerChild<decltype(vec)>;
 		unsigned long long size = 0;
@@ -0,0 +1,116 @@
+﻿#include "BootCache.hpp"
+
+#include "Chipset/Chipset.hpp"
+#include "Emulator.hpp"
+#include "Logger.hpp"
+#include "SaveState.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <system_error>
+
+namespace casioemu {
+	BootCache::BootCache(Emulator& _emulator, std::string _directory) : emulator(_emulator), directory(std::move(_directory)) {
+	}
+
+	bool BootCache::Restore() {
+		char name[48];
+		snprintf(name, sizeof(name), "%016llx-v%u.state", (unsigned long long)emulator.GetModelHash(), (unsigned int)state_version);
+		path = (std::filesystem::path(directory) / name).string();
+
+		std::ifstream is(path, std::ifstream::binary);
+		if (!is) {
+			StartCapture();
+			return false;
+		}
+		// A failed load leaves the machine as it was, booting from the reset.
+		if (!emulator.LoadState(is)) {
+			logger::Info("[BootCache][Info] %s is outdated or damaged, booting normally\n", path.c_str());
+			is.close();
+			std::error_code ec;
+			std::filesystem::remove(path, ec);
+			StartCapture();
+			return false;
+		}
+		logger::Info("[BootCache][Info] Restored boot state from %s\n", path.c_str());
+		return true;
+	}
+
+	void BootCache::StartCapture() {
+		window_ticks = emulator.chipset.ticks_elapsed;
+		window_instructions = emulator.chipset.instructions_executed;
+		idle_windows = 0;
+		pending = true;
+	}
+
+	void BootCache::Poll() {
+		if (!pending)
+			return;
+		auto& chipset = emulator.chipset;
+		// A rewind or a loaded state took the machine back past the window, start over from there.
+		if (chipset.ticks_elapsed < window_ticks || chipset.instructions_executed < window_instructions) {
+			StartCapture();
+			return;
+		}
+		uint64_t ticks = chipset.ticks_elapsed - window_ticks;
+		if (ticks < emulator.GetCyclesPerSecond() / windows_per_second)
+			return;
+		// Idle means less than one instruction per 64 cycles, a busy firmware runs several times that.
+		uint64_t instructions = chipset.instructions_executed - window_instructions;
+		idle_windows = instructions * 64 < ticks ? idle_windows + 1 : 0;
+		window_ticks = chipset.ticks_elapsed;
+		window_instructions = chipset.instructions_executed;
+		if (idle_windows >= settle_windows)
+			Capture();
+	}
+
+	void BootCache::Capture() {
+		pending = false;
+		std::ostringstream state;
+		emulator.SaveState(state);
+		captured = state.str();
+
+		std::error_code ec;
+		std::filesystem::create_directories(directory, ec);
+		// Parallel instances, possibly in other processes, may capture the same model. Each writes
+		// its own file and renames it, the address only tells instances of this process apart.
+		auto temporary = path + "." + std::to_string(std::random_device{}()) + "-" + std::to_string((uintptr_t)this) + ".tmp";
+		{
+			std::ofstream os(temporary, std::ofstream::binary);
+			if (os)
+				os.write(captured.data(), captured.size());
+			if (!os) {
+				logger::Info("[BootCache][Info] Cannot write %s\n", temporary.c_str());
+				os.close();
+				std::filesystem::remove(temporary, ec);
+				return;
+			}
+		}
+		std::filesystem::rename(temporary, path, ec);
+		if (ec) {
+			logger::Info("[BootCache][Info] Cannot write %s: %s\n", path.c_str(), ec.message().c_str());
+			std::filesystem::remove(temporary, ec);
+			return;
+		}
+		logger::Info("[BootCache][Info] Saved boot state to %s\n", path.c_str());
+	}
+
+	bool BootCache::RestoreCaptured() {
+		if (captured.empty())
+			return false;
+		std::istringstream is(captured);
+		return emulator.LoadState(is);
+	}
+
+	void BootCache::Cancel() {
+		if (pending)
+			logger::Info("[BootCache][Info] Input during boot, not caching it\n");
+		pending = false;
+	}
+
+	bool BootCache::Pending() {
+		return pending;
+	}
+} // namespace casioemu
@@ -0,0 +1,60 @@
+﻿#pragma once
+#include "Config.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace casioemu {
+	class Emulator;
+
+	/**
+	 * Skips the firmware boot on warm starts. Given `boot_cache=<dir>`, the first start of a model
+	 * boots as usual and saves the machine state to <dir> once the firmware settles in its idle key
+	 * wait; later starts with the same ROM, flash and config.bin restore that state instead. The
+	 * file is named after Emulator::GetModelHash and the save state version, so a changed model or
+	 * a build that writes another state layout simply misses.
+	 *
+	 * The firmware is considered idle when the CPU spends nearly all emulated time halted, stopped
+	 * or in the TI key wait for `settle_windows` windows in a row. A key press before that cancels
+	 * the capture, so a cached state never contains input. Not used when a RAM image is loaded.
+	 * Everything but the constructor and Pending runs on the emulation thread.
+	 */
+	class BootCache {
+		Emulator& emulator;
+		std::string directory, path;
+		std::string captured;
+
+		std::atomic<bool> pending{false};
+		uint64_t window_ticks = 0, window_instructions = 0;
+		int idle_windows = 0;
+
+		static const int windows_per_second = 8;
+		static const int settle_windows = 8;
+
+		void StartCapture();
+		void Capture();
+
+	public:
+		BootCache(Emulator& emulator, std::string directory);
+
+		/**
+		 * Loads the cached boot state. Returns false if there's none yet, the capture is armed then.
+		 */
+		bool Restore();
+		/**
+		 * Checks for the idle state and captures it. Called between instruction slices.
+		 */
+		void Poll();
+		void Cancel();
+		/**
+		 * Goes back to the state this instance captured, so a first boot continues from exactly
+		 * where a later cache hit starts. Returns false if nothing was captured.
+		 */
+		bool RestoreCaptured();
+		/**
+		 * True while the boot of this instance may still be captured.
+		 */
+		bool Pending();
+	};
+} // namespace casioemu
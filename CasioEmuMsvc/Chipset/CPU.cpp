@@ -234,13 +234,10 @@ namespace casioemu {
 	}
 
 	CPU::CPU(Emulator& _emulator) : emulator(_emulator), reg_lr(reg_elr[0]), reg_lcsr(reg_ecsr[0]), reg_psw(reg_epsw[0]) {
-		opcode_dispatch = new OpcodeSource*[0x10000];
-		for (size_t ix = 0; ix != 0x10000; ++ix)
-			opcode_dispatch[ix] = nullptr;
+		opcode_dispatch = nullptr;
 	}
 
 	CPU::~CPU() {
-		delete[] opcode_dispatch;
 	}
 
 	void CPU::SetupInternals() {
@@ -257,31 +254,37 @@ namespace casioemu {
 	}
 
 	void CPU::SetupOpcodeDispatch() {
-		uint16_t* permutation_buffer = new uint16_t[0x10000];
-		for (size_t ix = 0; ix != sizeof(opcode_sources) / sizeof(opcode_sources[0]); ++ix) {
-			OpcodeSource& handler_stub = opcode_sources[ix];
-
-			uint16_t varying_bits = 0;
-			for (size_t ox = 0; ox != sizeof(impl_operands) / sizeof(impl_operands[0]); ++ox)
-				varying_bits |= handler_stub.operands[ox].mask << handler_stub.operands[ox].shift;
-
-			size_t permutation_count = 1;
-			permutation_buffer[0] = handler_stub.opcode;
-			for (uint16_t checkbit = 0x8000; checkbit; checkbit >>= 1) {
-				if (varying_bits & checkbit) {
-					for (size_t px = 0; px != permutation_count; ++px)
-						permutation_buffer[px + permutation_count] = permutation_buffer[px] | checkbit;
-					permutation_count <<= 1;
+		// The table only depends on `opcode_sources`, so it's built once and shared by every instance.
+		static OpcodeSource** shared_dispatch = [] {
+			auto dispatch = new OpcodeSource*[0x10000]();
+			uint16_t* permutation_buffer = new uint16_t[0x10000];
+			for (size_t ix = 0; ix != sizeof(opcode_sources) / sizeof(opcode_sources[0]); ++ix) {
+				OpcodeSource& handler_stub = opcode_sources[ix];
+
+				uint16_t varying_bits = 0;
+				for (size_t ox = 0; ox != sizeof(impl_operands) / sizeof(impl_operands[0]); ++ox)
+					varying_bits |= handler_stub.operands[ox].mask << handler_stub.operands[ox].shift;
+
+				size_t permutation_count = 1;
+				permutation_buffer[0] = handler_stub.opcode;
+				for (uint16_t checkbit = 0x8000; checkbit; checkbit >>= 1) {
+					if (varying_bits & checkbit) {
+						for (size_t px = 0; px != permutation_count; ++px)
+							permutation_buffer[px + permutation_count] = permutation_buffer[px] | checkbit;
+						permutation_count <<= 1;
+					}
 				}
-			}
 
-			for (size_t px = 0; px != permutation_count; ++px) {
-				if (opcode_dispatch[permutation_buffer[px]])
-					continue;
-				opcode_dispatch[permutation_buffer[px]] = &handler_stub;
+				for (size_t px = 0; px != permutation_count; ++px) {
+					if (dispatch[permutation_buffer[px]])
+						continue;
+					dispatch[permutation_buffer[px]] = &handler_stub;
+				}
 			}
-		}
-		delete[] permutation_buffer;
+			delete[] permutation_buffer;
+			return dispatch;
+		}();
+		opcode_dispatch = shared_dispatch;
 	}
 
 	void CPU::SetupRegisterProxies() {
@@ -386,7 +389,7 @@ namespace casioemu {
 		InstructionEventArgs iea{};
 		iea.pc_before = pc_before;
 		iea.pc_after = reg_csr << 16 | reg_pc;
-		RaiseEvent(on_instruction, *this, iea);
+		RaiseEvent(emulator.hooks.on_instruction, *this, iea);
 		if (iea.should_break) {
 			emulator.SetPaused(true);
 		}
@@ -435,12 +438,12 @@ namespace casioemu {
 		return reg_psw & PSW_MIE;
 	}
 
-	std::string CPU::GetBacktrace() const {
 #ifdef DBG
+	static std::string FormatBacktrace(const CPU::StackFrame* frames, size_t count, uint32_t lr) {
 		std::stringstream output;
 		output << std::hex << std::setfill('0') << std::uppercase;
-		auto stack = this->stack.get_const();
-		for (StackFrame frame : *stack) {
+		for (size_t i = 0; i != count; ++i) {
+			auto& frame = frames[i];
 			output << "  function "
 				   << std::setw(6) << (frame.new_pc)
 				   << " returns to " << std::setw(6);
@@ -451,7 +454,7 @@ namespace casioemu {
 					   << std::setw(4) << frame.lr_push_address;
 			}
 			else {
-				output << (((size_t)reg_lcsr) << 16 | reg_lr);
+				output << lr;
 			}
 			if (frame.is_jump) {
 				output << " (called by pop pc)";
@@ -459,8 +462,82 @@ namespace casioemu {
 			output << '\n';
 		}
 		return output.str();
+	}
+
+	std::string CPU::StackSnapshot::GetBacktrace() const {
+		return FormatBacktrace(frames, count, lr);
+	}
+#endif
+
+	std::string CPU::GetBacktrace() const {
+#ifdef DBG
+		auto stack = this->stack.get_const();
+		return FormatBacktrace(stack->data(), stack->size(), ((size_t)reg_lcsr) << 16 | reg_lr);
 #else
 		return "Disabled";
+#endif
+	}
+
+	void CPU::SaveState(std::ostream& os) {
+		// Register proxies carry a name, only the raw values are state.
+		auto save = [&](auto& regs, size_t count) {
+			for (size_t i = 0; i != count; ++i)
+				Binary::Write(os, regs[i].raw);
+		};
+		save(reg_r, 16);
+		save(reg_cr, 16);
+		save(reg_elr, 4);
+		save(reg_ecsr, 4);
+		save(reg_epsw, 4);
+		Binary::WriteAll(os, reg_pc.raw, reg_csr.raw, reg_sp.raw, reg_ea.raw, reg_dsr.raw, impl_last_dsr, fetch_addition);
+#ifdef DBG
+		Binary::Write(os, *stack.get_const());
+#endif
+	}
+
+	void CPU::LoadState(std::istream& is) {
+		auto load = [&](auto& regs, size_t count) {
+			for (size_t i = 0; i != count; ++i)
+				Binary::Read(is, regs[i].raw);
+		};
+		load(reg_r, 16);
+		load(reg_cr, 16);
+		load(reg_elr, 4);
+		load(reg_ecsr, 4);
+		load(reg_epsw, 4);
+		Binary::ReadAll(is, reg_pc.raw, reg_csr.raw, reg_sp.raw, reg_ea.raw, reg_dsr.raw, impl_last_dsr, fetch_addition);
+#ifdef DBG
+		auto frames = stack.get();
+		frames->clear();
+		Binary::Read(is, *frames);
+#endif
+	}
+
+	void CPU::PublishSnapshot() {
+		Snapshot regs;
+		for (int i = 0; i != 16; ++i)
+			regs.reg_r[i] = reg_r[i];
+		regs.reg_pc = reg_pc;
+		regs.reg_csr = reg_csr;
+		regs.reg_lr = reg_lr;
+		regs.reg_lcsr = reg_lcsr;
+		regs.reg_sp = reg_sp;
+		regs.reg_ea = reg_ea;
+		regs.reg_psw = reg_psw;
+		regs.reg_dsr = reg_dsr;
+		regs.run_mode = emulator.chipset.run_mode;
+		regs.instructions = emulator.chipset.instructions_executed;
+		snapshot.Store(regs);
+#ifdef DBG
+		StackSnapshot frames;
+		{
+			auto stack = this->stack.get_const();
+			frames.depth = stack->size();
+			frames.count = std::min(frames.depth, snapshot_stack_frames);
+			std::copy(stack->end() - frames.count, stack->end(), frames.frames);
+		}
+		frames.lr = (uint32_t)regs.reg_lcsr << 16 | regs.reg_lr;
+		stack_snapshot.Store(frames);
 #endif
 	}
 } // namespace casioemu
@@ -1,7 +1,11 @@
 ﻿#pragma once
 #include "Config.hpp"
+#include "Containers/SeqLock.h"
 #include "Logger.hpp"
 
+#include <istream>
+#include <ostream>
+
 namespace casioemu {
 	class Emulator;
 
@@ -144,6 +148,47 @@ namespace casioemu {
 		};
 		ConcurrentObject<std::vector<StackFrame>> stack;
 #endif
+
+		/**
+		 * Copy of the registers and run state for the debugger, published by the emulation thread
+		 * between instruction slices (`PublishSnapshot`). The UI reads this instead of the live
+		 * registers, so it never races with the CPU and never makes it wait.
+		 */
+		struct Snapshot {
+			uint8_t reg_r[16];
+			uint16_t reg_pc, reg_csr, reg_lr, reg_lcsr, reg_sp, reg_ea;
+			uint8_t reg_psw, reg_dsr;
+			int run_mode;
+			uint64_t instructions;
+			uint32_t GetPC() const {
+				return (uint32_t)reg_csr << 16 | reg_pc;
+			}
+			uint32_t GetLR() const {
+				return (uint32_t)reg_lcsr << 16 | reg_lr;
+			}
+		};
+		SeqLock<Snapshot> snapshot;
+#ifdef DBG
+		static const size_t snapshot_stack_frames = 64;
+		/**
+		 * The innermost `snapshot_stack_frames` entries of `stack`, outermost first. `depth` is the
+		 * size of the whole stack, `lr` the LR value shown for frames that didn't push it.
+		 */
+		struct StackSnapshot {
+			size_t depth, count;
+			uint32_t lr;
+			StackFrame frames[snapshot_stack_frames];
+			std::string GetBacktrace() const;
+		};
+		SeqLock<StackSnapshot> stack_snapshot;
+#endif
+		void PublishSnapshot();
+
+		/**
+		 * Registers and fetch state for Chipset::SaveState. Only valid between instructions.
+		 */
+		void SaveState(std::ostream& os);
+		void LoadState(std::istream& is);
 	private:
 		uint16_t Fetch();
 
@@ -177,7 +222,7 @@ namespace casioemu {
 			} operands[2];
 		};
 		static OpcodeSource opcode_sources[];
-		OpcodeSource** opcode_dispatch;
+		OpcodeSource** opcode_dispatch; // shared by all instances, see SetupOpcodeDispatch
 
 		typedef RegisterStub CPU::*RegisterStubPointer;
 		typedef RegisterStub (CPU::*RegisterStubArrayPointer)[];
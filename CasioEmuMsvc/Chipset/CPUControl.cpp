@@ -3,7 +3,6 @@
 #include "Chipset.hpp"
 #include "Emulator.hpp"
 #include "Gui/Hooks.h"
-#include "Ui.hpp"
 #include "MMU.hpp"
 
 #pragma warning(disable : 4244)
@@ -230,8 +229,8 @@ namespace casioemu {
 			// stack->clear();
 		}
 		stack->push_back(sf);
-		if (on_call_function)
-			on_call_function(*this, {sf.new_pc, (uint32_t)(reg_lcsr << 16 | reg_lr)});
+		if (emulator.hooks.on_call_function)
+			emulator.hooks.on_call_function(*this, {sf.new_pc, (uint32_t)(reg_lcsr << 16 | reg_lr)});
 #endif
 	}
 
@@ -104,7 +104,7 @@ namespace casioemu {
 							stack->back().is_jump = true;
 						}
 						else {
-							RaiseEvent(on_function_return, *this, FunctionEventArgs{oldaddr, (uint32_t)reg_pc | reg_csr << 16});
+							RaiseEvent(emulator.hooks.on_function_return, *this, FunctionEventArgs{oldaddr, (uint32_t)reg_pc | reg_csr << 16});
 							stack->pop_back();
 						}
 					}
@@ -21,7 +21,9 @@
 #include "PowerSupply.hpp"
 #include "ROMWindow.hpp"
 #include "RealTimeClock.hpp"
+#include "RomImage.hpp"
 #include "Romu.h"
+#include "SaveState.hpp"
 #include "Screen.hpp"
 #include "StandbyControl.hpp"
 #include "Timer.hpp"
@@ -30,6 +32,7 @@
 #include "WatchdogTimer.hpp"
 #include <ML620Ports.h>
 #include <algorithm>
+#include <bit>
 #include <cmath>
 #include <cstring>
 #include <fstream>
@@ -46,12 +49,18 @@ namespace casioemu {
 	Chipset::Chipset(Emulator& _emulator) : emulator(_emulator), cpu(*new CPU(emulator)), mmu(*new MMU(emulator)) {
 		tiDiagMode = false;
 		tiKey = 0;
+		ti_key_wait = false;
+		ti_key_wait_cycles = 0;
+		ticks_elapsed = 0;
+		instructions_executed = 0;
+		clock_domains_dirty = true;
 	}
 
 	void Chipset::Setup() {
-		for (size_t ix = 0; ix != INT_COUNT; ++ix)
-			interrupts_active[ix] = false;
-		pending_interrupt_count = 0;
+		for (auto& word : interrupts_active)
+			word = 0;
+		interrupts_changed = true;
+		interrupt_gate_key = 0;
 
 		cpu.SetMemoryModel(CPU::MM_LARGE);
 		cpu.SetCPUModel(emulator.hardware_id == HW_CLASSWIZ || emulator.hardware_id == HW_CLASSWIZ_II || emulator.hardware_id == HW_TI ? CPU::CM_NX_U16 : CPU::CM_NX_U8);
@@ -287,10 +296,7 @@ namespace casioemu {
 					offset -= region->base;
 					chipset->data_LTBADJ = (chipset->data_LTBADJ & (~(0xFF << offset * 8))) | (data << offset * 8);
 					chipset->data_LTBADJ &= 0x7FF;
-					if (chipset->data_LTBADJ != 0)
-						chipset->LSCLKThresh = (chipset->LSCLKFreq * (1 + 2097152 / (short)chipset->data_LTBADJ)) / chipset->emulator.GetCyclesPerSecond();
-					else
-						chipset->LSCLKThresh = 0;
+					chipset->UpdateClockDividers();
 				},
 				emulator);
 		}
@@ -334,10 +340,7 @@ namespace casioemu {
 			offset -= region->base;
 			chipset->data_LTBADJ = (chipset->data_LTBADJ & (~(0xFF << offset * 8))) | (data << offset * 8);
 			chipset->data_LTBADJ &= 0x7FF;
-			if(chipset->data_LTBADJ != 0)
-				chipset->LSCLKThresh = (chipset->LSCLKFreq * (1 + 2097152 / (short)chipset->data_LTBADJ)) / chipset->emulator.GetCyclesPerSecond();
-			else
-				chipset->LSCLKThresh = 0; }, emulator);
+			chipset->UpdateClockDividers(); }, emulator);
 		}
 	}
 
@@ -376,7 +379,7 @@ namespace casioemu {
 
 		// Generate LSCLK Tick
 		if (LSCLKMode) {
-			if (++LSCLKTickCounter >= emulator.GetCyclesPerSecond() / LSCLKFreq + LSCLKFreqAddition) {
+			if (++LSCLKTickCounter >= LSCLKPeriod + LSCLKFreqAddition) {
 				LSCLKTick = true;
 				LSCLKTickCounter = 0;
 				if (LSCLKFreqAddition != 0) {
@@ -394,6 +397,14 @@ namespace casioemu {
 		}
 	}
 
+	void Chipset::UpdateClockDividers() {
+		if (data_LTBADJ != 0)
+			LSCLKThresh = (LSCLKFreq * (1 + 2097152 / (short)data_LTBADJ)) / emulator.GetCyclesPerSecond();
+		else
+			LSCLKThresh = 0;
+		LSCLKPeriod = emulator.GetCyclesPerSecond() / LSCLKFreq;
+	}
+
 	void Chipset::ResetClockGenerator() {
 		data_FCON = 0;
 		data_LTBR = 0;
@@ -414,10 +425,10 @@ namespace casioemu {
 		LSCLKTickCounter = 0;
 		LSCLKTimeCounter = 0;
 		LSCLKFreqAddition = 0;
-		LSCLKThresh = 0;
 		HSCLKTickCounter = 0;
 		HSCLKTimeCounter = 0;
 		SYSCLKTickCounter = 0;
+		UpdateClockDividers();
 	}
 
 	void Chipset::DestructClockGenerator() {
@@ -436,19 +447,8 @@ namespace casioemu {
 			Chipset* chipset = (Chipset*)region->userdata;
 			return (uint8_t)(chipset->data_BLKCON & chipset->BLKCON_mask); }, [](MMURegion* region, size_t, uint8_t data) {
 			Chipset* chipset = (Chipset*)region->userdata;
-			data &= chipset->BLKCON_mask;
-			chipset->data_BLKCON = data;
-			for(auto peripheral : chipset->peripherals) {
-				int block_bit = peripheral->block_bit;
-				if(block_bit == -1)
-					continue;
-				if((1 << block_bit) > chipset->BLKCON_mask)
-					PANIC("Invalid BLKCON0 bit %d\n", block_bit);
-				if(data & (1 << block_bit))
-					peripheral->Uninitialise();
-				else
-					peripheral->Initialise();
-			} }, emulator);
+			chipset->data_BLKCON = data & chipset->BLKCON_mask;
+			chipset->ApplyBLKCON(); }, emulator);
 		}
 
 		ioport = new IOPorts(emulator);
@@ -489,6 +489,20 @@ namespace casioemu {
 		}
 	}
 
+	void Chipset::ApplyBLKCON() {
+		for (auto peripheral : peripherals) {
+			int block_bit = peripheral->block_bit;
+			if (block_bit == -1)
+				continue;
+			if ((1 << block_bit) > BLKCON_mask)
+				PANIC("Invalid BLKCON0 bit %d\n", block_bit);
+			if (data_BLKCON & (1 << block_bit))
+				peripheral->Uninitialise();
+			else
+				peripheral->Initialise();
+		}
+	}
+
 	void Chipset::DestructPeripherals() {
 		region_BLKCON.Kill();
 
@@ -499,34 +513,48 @@ namespace casioemu {
 	}
 
 	void Chipset::SetupInternals() {
-		std::ifstream rom_handle(emulator.GetModelFilePath(emulator.modeldef.rom_path), std::ifstream::binary);
-		if (rom_handle.fail())
-			PANIC("std::ifstream failed: %s\n", std::strerror(errno));
-		rom_data = std::vector<unsigned char>((std::istreambuf_iterator<char>(rom_handle)), std::istreambuf_iterator<char>());
-
+		// Read-only images are shared by every instance of the model; see RomImage.
+		std::string flash_path;
 		if (emulator.hardware_id == HW_FX_5800P) {
-			std::ifstream flash_handle(emulator.GetModelFilePath(emulator.modeldef.flash_path), std::ifstream::binary);
-			if (flash_handle.fail())
-				PANIC("std::ifstream failed: %s\n", std::strerror(errno));
-			flash_data = std::vector<unsigned char>((std::istreambuf_iterator<char>(flash_handle)), std::istreambuf_iterator<char>());
-			flash_data.resize(0x80000, 0xff);
-			memset(&flash_data[0x20000], 0xff, 0x10000); // TODO: check clear ram flag
-			memset(&flash_data[0x30000], 0, 0x8000);
-			memset(&flash_data[0x38000], 0xff, 0x8000);
-			flash_data[0x37FFE] = 0xff;
-			flash_data[0x37FFF] = 0x44;
+			flash_path = emulator.GetModelFilePath(emulator.modeldef.flash_path);
+			flash_data = RomImage::Share(flash_path, [&] {
+				auto flash = RomImage::LoadFile(flash_path, 0x80000, 0xff);
+				auto bytes = flash.data.get();
+				flash.size = 0x80000;
+				memset(&bytes[0x20000], 0xff, 0x10000); // TODO: check clear ram flag
+				memset(&bytes[0x30000], 0, 0x8000);
+				memset(&bytes[0x38000], 0xff, 0x8000);
+				bytes[0x37FFE] = 0xff;
+				bytes[0x37FFF] = 0x44;
+				return flash;
+			});
 		}
-		{
-			auto ri = rom_info(rom_data, flash_data);
+		auto rom_path = emulator.GetModelFilePath(emulator.modeldef.rom_path);
+		auto hardware_id = emulator.hardware_id;
+		// Checksumming reads the whole image, so it's only done when asked for.
+		bool verify_rom = emulator.argv_map.find("verify_rom") != emulator.argv_map.end();
+		// The loader sizes the image to the ROM window of the hardware and rom_info may patch it
+		// using the flash, so the same file opened as another model is a different image.
+		auto rom_key = rom_path + "|" + std::to_string(hardware_id) + "|" + flash_path;
+		rom_data = RomImage::Share(rom_key, [&] {
+			auto window_size = GetRomWindowSize(hardware_id);
+			auto rom = RomImage::LoadFile(rom_path, window_size);
+			// rom_info moves the version block of some ClassWiz II dumps into place, so it runs
+			// before the image is shared and sized to the ROM window.
+			auto ri = rom_info(rom.data.get(), rom.size, flash_data.data(), flash_data.size(), verify_rom);
 			if (ri.ok) {
 				printf("[Chipset][Info] Model:       %s\n", ri.ver);
 				printf("[Chipset][Info] CalcID:      %llx\n", *(unsigned long long*)ri.cid);
-				printf("[Chipset][Info] Target SUM:  %02x ,Calculated SUM: %02x\n", ri.desired_sum, ri.real_sum);
-				auto res = (ri.real_sum == ri.desired_sum);
-				if (res != real_hardware)
-					printf("[Chipset][Warn] SUM %s!\n", res ? "OK" : "NG");
+				if (verify_rom) {
+					printf("[Chipset][Info] Target SUM:  %02x ,Calculated SUM: %02x\n", ri.desired_sum, ri.real_sum);
+					auto res = (ri.real_sum == ri.desired_sum);
+					if (res != real_hardware)
+						printf("[Chipset][Warn] SUM %s!\n", res ? "OK" : "NG");
+				}
 			}
-		}
+			rom.size = window_size;
+			return rom;
+		});
 		GetRamSize(emulator.hardware_id);
 		for (auto& peripheral : peripherals)
 			peripheral->Initialise();
@@ -541,21 +569,22 @@ namespace casioemu {
 	void Chipset::Reset() {
 		ResetInterruptSFR();
 		isMIBlocked = false;
+		ti_key_wait = false;
 
 		ResetClockGenerator();
 
 		SegmentAccess = false;
 		data_BLKCON = 0;
 
-		RaiseEvent(on_reset, *this);
+		RaiseEvent(emulator.hooks.on_reset, *this);
 
 		for (auto& peripheral : peripherals)
 			peripheral->Reset();
 
 		cpu.Reset();
 
-		interrupts_active[INT_RESET] = true;
-		pending_interrupt_count = 1;
+		interrupts_active[0] = interrupts_active[1] = 0;
+		SetInterruptActive(INT_RESET);
 
 		run_mode = RM_RUN;
 	}
@@ -568,14 +597,11 @@ namespace casioemu {
 
 		InterruptEventArgs iea{};
 		iea.index = INT_BREAK;
-		RaiseEvent(on_brk, *this, iea);
+		RaiseEvent(emulator.hooks.on_brk, *this, iea);
 		if (iea.handled)
 			return;
 
-		if (interrupts_active[INT_BREAK])
-			return;
-		interrupts_active[INT_BREAK] = true;
-		pending_interrupt_count++;
+		SetInterruptActive(INT_BREAK);
 	}
 
 	void Chipset::Halt() {
@@ -593,10 +619,7 @@ namespace casioemu {
 	}
 
 	void Chipset::RaiseEmulator() {
-		if (interrupts_active[INT_EMULATOR])
-			return;
-		interrupts_active[INT_EMULATOR] = true;
-		pending_interrupt_count++;
+		SetInterruptActive(INT_EMULATOR);
 	}
 
 	void Chipset::RequestNonmaskable() {
@@ -609,21 +632,15 @@ namespace casioemu {
 
 		InterruptEventArgs iea{};
 		iea.index = INT_MASKABLE;
-		RaiseEvent(on_interrupt, *this, iea);
+		RaiseEvent(emulator.hooks.on_interrupt, *this, iea);
 		if (iea.handled)
 			return;
 
-		if (interrupts_active[INT_NONMASKABLE])
-			return;
-		interrupts_active[INT_NONMASKABLE] = true;
-		pending_interrupt_count++;
+		SetInterruptActive(INT_NONMASKABLE);
 	}
 
 	void Chipset::ResetNonmaskable() {
-		if (!interrupts_active[INT_NONMASKABLE])
-			return;
-		interrupts_active[INT_NONMASKABLE] = false;
-		pending_interrupt_count--;
+		ClearInterruptActive(INT_NONMASKABLE);
 	}
 
 	void Chipset::RaiseMaskable(size_t index) {
@@ -632,37 +649,25 @@ namespace casioemu {
 
 		InterruptEventArgs iea{};
 		iea.index = static_cast<uint8_t>(index); // this conversion is guaranteed
-		RaiseEvent(on_interrupt, *this, iea);
+		RaiseEvent(emulator.hooks.on_interrupt, *this, iea);
 		if (iea.handled)
 			return;
 
-		if (interrupts_active[index])
-			return;
-
-		interrupts_active[index] = true;
-		pending_interrupt_count++;
+		SetInterruptActive(index);
 	}
 
 	void Chipset::ResetMaskable(size_t index) {
 		if (index < INT_MASKABLE || index >= INT_SOFTWARE)
 			PANIC("%zu is not a valid maskable interrupt index\n", index);
-		if (!interrupts_active[index])
-			return;
-		interrupts_active[index] = false;
-		pending_interrupt_count--;
+		ClearInterruptActive(index);
 	}
 
 	void Chipset::RaiseSoftware(size_t index) {
 		if (emulator.modeldef.hardware_id == HW_TI) {
 			if ((tiDiagMode || !emulator.modeldef.real_hardware) && index == 0x02) {
-				int dl = 500;
-				while (dl > 0 && tiKey == 0) {
-					SDL_Delay(24);
-					dl -= 24;
-				}
-				emulator.chipset.cpu.reg_r[1] = 0;
-				emulator.chipset.cpu.reg_r[0] = tiKey;
-				tiKey = 0;
+				// Finished by TickKeyWait once a key arrives or the wait times out.
+				ti_key_wait = true;
+				ti_key_wait_cycles = emulator.GetCyclesPerSecond() / 2;
 				return;
 			}
 			if (!emulator.modeldef.real_hardware) {
@@ -671,11 +676,7 @@ namespace casioemu {
 				return;
 			}
 		}
-		index += 0x40;
-		if (interrupts_active[index])
-			return;
-		interrupts_active[index] = true;
-		pending_interrupt_count++;
+		SetInterruptActive(index + INT_SOFTWARE);
 	}
 
 	void Chipset::AcceptInterrupt() {
@@ -683,40 +684,33 @@ namespace casioemu {
 
 		size_t index = 0;
 		bool acceptable = true;
+		uint64_t active = interrupts_active[0];
 		// * Reset has priority over everything.
-		if (interrupts_active[INT_RESET])
+		if (IsInterruptActive(INT_RESET))
 			index = INT_RESET;
 		// * Software interrupts are immediately accepted.
-		if (!index)
-			for (size_t ix = INT_SOFTWARE; ix != INT_COUNT; ++ix)
-				if (interrupts_active[ix]) {
-					if (old_exception_level > 1)
-						logger::Info("software interrupt while exception level was greater than 1\n"); // test on real hardware shows that SWI seems to be raised normally when ELEVEL=2
-					index = ix;
-					break;
-				}
+		else if (interrupts_active[1]) {
+			if (old_exception_level > 1)
+				logger::Info("software interrupt while exception level was greater than 1\n"); // test on real hardware shows that SWI seems to be raised normally when ELEVEL=2
+			index = INT_SOFTWARE + std::countr_zero(interrupts_active[1]);
+		}
 		// * No need to check the old exception level as NMICI has an exception level of 3.
-		if (!index && interrupts_active[INT_EMULATOR])
+		else if (IsInterruptActive(INT_EMULATOR))
 			index = INT_EMULATOR;
 		// * No need to check the old exception level as BRK initiates a reset if
 		//   the currect exception level is greater than 1.
-		if (!index && interrupts_active[INT_BREAK])
+		else if (IsInterruptActive(INT_BREAK))
 			index = INT_BREAK;
-		if (!index && interrupts_active[INT_NONMASKABLE]) {
+		else if (IsInterruptActive(INT_NONMASKABLE)) {
 			index = INT_NONMASKABLE;
 			if (old_exception_level > 2) {
 				acceptable = false;
 			}
 		}
-		if (!index) {
-			for (size_t ix = INT_MASKABLE; ix != INT_SOFTWARE; ++ix) {
-				if (interrupts_active[ix]) {
-					index = ix;
-					if (old_exception_level > 1) {
-						acceptable = false;
-					}
-					break;
-				}
+		else if (active & maskable_interrupt_bits) {
+			index = std::countr_zero(active & maskable_interrupt_bits);
+			if (old_exception_level > 1) {
+				acceptable = false;
 			}
 		}
 
@@ -745,27 +739,28 @@ namespace casioemu {
 				SetInterruptPendingSFR(index, false);
 				cpu.Raise(exception_level, index);
 
-				interrupts_active[index] = false;
-				pending_interrupt_count--;
+				ClearInterruptActive(index);
 			}
 		}
 		else if (index == INT_NONMASKABLE) {
 			if (acceptable) {
 				cpu.Raise(exception_level, index);
 				SetInterruptPendingSFR(INT_NONMASKABLE, false);
-				interrupts_active[index] = false;
-				pending_interrupt_count--;
+				ClearInterruptActive(index);
 			}
 		}
 		else {
 			cpu.Raise(exception_level, index);
-			interrupts_active[index] = false;
-			pending_interrupt_count--;
+			ClearInterruptActive(index);
 		}
 
 		run_mode = RM_RUN;
 	}
 
+	unsigned int Chipset::GetInterruptGateKey() {
+		return (cpu.reg_psw.raw & (CPU::PSW_MIE | CPU::PSW_ELEVEL)) | (isMIBlocked ? 0x100 : 0);
+	}
+
 	bool Chipset::GetInterruptPendingSFR(size_t index) {
 		return data_int_pending & (static_cast<unsigned long long>(1) << (index - managed_interrupt_base));
 	}
@@ -825,57 +820,60 @@ namespace casioemu {
 	void Chipset::Tick() {
 		// * TODO: decrement delay counter, return if it's not 0
 
+		if (clock_domains_dirty)
+			RebuildClockDomains();
+
 		if (real_hardware) {
 			GenerateTickForClock();
 
-			for (auto& peripheral : peripherals) {
-				switch (peripheral->clock_type) {
-				case CLOCK_UNDEFINED:
+			for (auto peripheral : clock_domains[CLOCK_UNDEFINED])
+				peripheral->Tick();
+			if (LTBCReset)
+				for (auto peripheral : clock_domains[CLOCK_LSCLK])
+					peripheral->ResetLSCLK();
+			if (LSCLKTick)
+				for (auto peripheral : clock_domains[CLOCK_LSCLK])
+					peripheral->Tick();
+			if (HSCLKTick)
+				for (auto peripheral : clock_domains[CLOCK_HSCLK])
+					peripheral->Tick();
+			if (SYSCLKTick)
+				for (auto peripheral : clock_domains[CLOCK_SYSCLK])
 					peripheral->Tick();
-					break;
-				case CLOCK_LSCLK:
-					if (LTBCReset)
-						peripheral->ResetLSCLK();
-					if (LSCLKTick)
-						peripheral->Tick();
-					break;
-				case CLOCK_HSCLK:
-					if (HSCLKTick)
-						peripheral->Tick();
-					break;
-				case CLOCK_SYSCLK:
-					if (SYSCLKTick)
-						peripheral->Tick();
-					break;
-				default:
-					break;
-				}
-			}
 		}
 		else {
-			for (auto& peripheral : peripherals) {
-				switch (peripheral->clock_type) {
-				case CLOCK_UNDEFINED:
-				case CLOCK_HSCLK:
-				case CLOCK_SYSCLK:
-					peripheral->Tick();
-					break;
-				default:
-					break;
-				}
-			}
+			for (auto peripheral : clock_domains[CLOCK_UNDEFINED])
+				peripheral->Tick();
+			for (auto peripheral : clock_domains[CLOCK_HSCLK])
+				peripheral->Tick();
+			for (auto peripheral : clock_domains[CLOCK_SYSCLK])
+				peripheral->Tick();
 			HSCLKTick = SYSCLKTick = true;
 		}
 
-		if (pending_interrupt_count) {
-			AcceptInterrupt();
-			for (auto peripheral : peripherals)
-				peripheral->TickAfterInterrupts();
+		if (AnyInterruptActive()) {
+			auto gate_key = GetInterruptGateKey();
+			if (interrupts_changed || gate_key != interrupt_gate_key) {
+				interrupts_changed = false;
+				AcceptInterrupt();
+				interrupt_gate_key = GetInterruptGateKey();
+				for (auto peripheral : peripherals)
+					peripheral->TickAfterInterrupts();
+			}
+			else {
+				// Still masked, only the wake-up side of AcceptInterrupt applies.
+				run_mode = RM_RUN;
+			}
 		}
 
-		if (run_mode == RM_RUN && SYSCLKTick) {
+		if (ti_key_wait) {
+			TickKeyWait();
+		}
+		else if (run_mode == RM_RUN && SYSCLKTick) {
 			cpu.Next();
+			++instructions_executed;
 		}
+		++ticks_elapsed;
 
 		LSCLKTick = false;
 		LTBCReset = false;
@@ -883,19 +881,200 @@ namespace casioemu {
 		SYSCLKTick = false;
 	}
 
+	void Chipset::TickKeyWait() {
+		if (tiKey == 0 && ti_key_wait_cycles != 0) {
+			--ti_key_wait_cycles;
+			return;
+		}
+		ti_key_wait = false;
+		cpu.reg_r[1] = 0;
+		cpu.reg_r[0] = tiKey.exchange(0);
+	}
+
+	void Chipset::SetTIKey(int key) {
+		{
+			std::lock_guard<std::mutex> lock(ti_key_mutex);
+			tiKey = key;
+		}
+		ti_key_cv.notify_all();
+	}
+
+	void Chipset::InterruptKeyWait() {
+		std::lock_guard<std::mutex> lock(ti_key_mutex);
+		ti_key_cv.notify_all();
+	}
+
+	bool Chipset::WaitForKey(std::chrono::milliseconds timeout) {
+		// Let Tick finish the wait once there's a key or the time is up.
+		if (!ti_key_wait || tiKey != 0 || ti_key_wait_cycles == 0)
+			return false;
+		auto start = std::chrono::steady_clock::now();
+		{
+			std::unique_lock<std::mutex> lock(ti_key_mutex);
+			ti_key_cv.wait_for(lock, timeout, [this] { return tiKey != 0 || emulator.HasPendingCommands(); });
+		}
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+		uint64_t cycles = (uint64_t)emulator.GetCyclesPerSecond() * elapsed.count() / 1000000;
+		ti_key_wait_cycles = ti_key_wait_cycles > cycles ? ti_key_wait_cycles - cycles : 0;
+		return true;
+	}
+
 	void Chipset::EmulatorTick() {
-		for (auto& peripheral : peripherals) {
-			switch (peripheral->clock_type) {
-			case CLOCK_LSCLK:
-			case CLOCK_EMUCLK:
-				peripheral->Tick();
-				break;
-			default:
-				break;
-			}
+		if (clock_domains_dirty)
+			RebuildClockDomains();
+
+		for (auto peripheral : clock_domains[CLOCK_LSCLK])
+			peripheral->Tick();
+		for (auto peripheral : clock_domains[CLOCK_EMUCLK])
+			peripheral->Tick();
+	}
+
+	void Chipset::InvalidateClockDomains() {
+		clock_domains_dirty = true;
+	}
+
+	void Chipset::RebuildClockDomains() {
+		for (auto& domain : clock_domains)
+			domain.clear();
+		for (auto peripheral : peripherals)
+			if (peripheral->clock_type >= CLOCK_UNDEFINED && peripheral->clock_type < CLOCK_STOPPED)
+				clock_domains[peripheral->clock_type].push_back(peripheral);
+		clock_domains_dirty = false;
+	}
+
+	void Chipset::SaveState(StateWriter& writer) {
+		SaveCoreState(writer);
+		SaveMemory(writer);
+	}
+
+	bool Chipset::LoadState(StateReader& reader) {
+		return LoadCoreState(reader) && LoadMemory(reader);
+	}
+
+	void Chipset::SaveCoreState(StateWriter& writer) {
+		writer.Section("CHIP", [&](std::ostream& os) {
+			Binary::WriteAll(os, data_int_mask, data_int_pending, interrupts_active, interrupt_gate_key, run_mode, isMIBlocked);
+			Binary::WriteAll(os, data_BLKCON, data_EXICON, data_FCON, data_FCON1, data_LTBR, data_HTBR, data_LTBADJ, LSCLKFreq, ClockDiv, LSCLKMode);
+			Binary::WriteAll(os, HSCLKTickCounter, HSCLKTimeCounter, SYSCLKTickCounter, LSCLKThresh, LSCLKTickCounter, LSCLKTimeCounter, LSCLKFreqAddition, LSCLKPeriod);
+			Binary::WriteAll(os, LSCLK_output, HSCLK_output, LSCLKTick, HSCLKTick, SYSCLKTick, LTBCReset, HTBCReset);
+			Binary::WriteAll(os, Port0Inputlevel, Port1Inputlevel, Port0Outputlevel, Port1Outputlevel, UserInput_level_Port0, UserInput_level_Port1, UserInput_state_Port0, UserInput_state_Port1);
+			Binary::WriteAll(os, remap, SegmentAccess, ticks_elapsed, instructions_executed, tiDiagMode, tiKey.load(), ti_key_wait, ti_key_wait_cycles);
+		});
+		writer.Section("CPU ", [&](std::ostream& os) {
+			cpu.SaveState(os);
+		});
+		size_t index = 0;
+		for (auto peripheral : peripherals) {
+			writer.Section(PeripheralTag(index++).c_str(), [&](std::ostream& os) {
+				Binary::Write(os, peripheral->clock_type);
+				peripheral->SaveState(os);
+			});
 		}
 	}
 
+	void Chipset::SaveMemory(StateWriter& writer) {
+		writer.Section("RAM ", [&](std::ostream& os) {
+			if (auto ram = QueryInterface<IRam>())
+				for (auto& range : ram->GetRanges())
+					os.write((const char*)range.data, range.size);
+		});
+		// Images are only part of the state once firmware wrote to them.
+		for (auto image : {&rom_data, &flash_data}) {
+			writer.Section(image == &rom_data ? "ROM " : "FLSH", [&](std::ostream& os) {
+				bool written = !image->IsShared() && !image->empty();
+				Binary::Write(os, written);
+				if (written)
+					os.write((const char*)image->data(), image->size());
+			});
+		}
+	}
+
+	bool Chipset::LoadCoreState(StateReader& reader) {
+		bool ok = reader.Section("CHIP", [&](std::istream& is) {
+			Binary::ReadAll(is, data_int_mask, data_int_pending);
+			for (size_t i = 0; i < EffectiveMICount; i++)
+				MaskableInterrupts[i].SetEnabled(data_int_mask & (static_cast<unsigned long long>(1) << (i + 1)));
+			Binary::ReadAll(is, interrupts_active, interrupt_gate_key, run_mode, isMIBlocked);
+			interrupts_changed = true;
+			Binary::ReadAll(is, data_BLKCON, data_EXICON, data_FCON, data_FCON1, data_LTBR, data_HTBR, data_LTBADJ, LSCLKFreq, ClockDiv, LSCLKMode);
+			Binary::ReadAll(is, HSCLKTickCounter, HSCLKTimeCounter, SYSCLKTickCounter, LSCLKThresh, LSCLKTickCounter, LSCLKTimeCounter, LSCLKFreqAddition, LSCLKPeriod);
+			Binary::ReadAll(is, LSCLK_output, HSCLK_output, LSCLKTick, HSCLKTick, SYSCLKTick, LTBCReset, HTBCReset);
+			Binary::ReadAll(is, Port0Inputlevel, Port1Inputlevel, Port0Outputlevel, Port1Outputlevel, UserInput_level_Port0, UserInput_level_Port1, UserInput_state_Port0, UserInput_state_Port1);
+			int ti_key;
+			Binary::ReadAll(is, remap, SegmentAccess, ticks_elapsed, instructions_executed, tiDiagMode, ti_key, ti_key_wait, ti_key_wait_cycles);
+			tiKey = ti_key;
+		});
+		if (!ok)
+			return false;
+		if (emulator.hardware_id != HW_TI)
+			ApplyBLKCON();
+
+		if (!reader.Section("CPU ", [&](std::istream& is) { cpu.LoadState(is); }))
+			return false;
+		size_t index = 0;
+		for (auto peripheral : peripherals) {
+			ok = reader.Section(PeripheralTag(index++).c_str(), [&](std::istream& is) {
+				int clock_type;
+				Binary::Read(is, clock_type);
+				peripheral->SetClockType(clock_type);
+				peripheral->LoadState(is);
+			});
+			if (!ok)
+				return false;
+		}
+		return true;
+	}
+
+	bool Chipset::LoadMemory(StateReader& reader) {
+		bool ok = reader.Section("RAM ", [&](std::istream& is) {
+			if (auto ram = QueryInterface<IRam>())
+				for (auto& range : ram->GetRanges())
+					is.read((char*)range.data, range.size);
+		});
+		if (!ok)
+			return false;
+		for (auto image : {&rom_data, &flash_data}) {
+			ok = reader.Section(image == &rom_data ? "ROM " : "FLSH", [&](std::istream& is) {
+				bool written;
+				Binary::Read(is, written);
+				if (written)
+					is.read((char*)image->MakeWritable(), image->size());
+				else
+					image->Discard();
+			});
+			if (!ok)
+				return false;
+		}
+		return true;
+	}
+
+	bool Chipset::CheckState(StateReader& reader, bool memory) {
+		if (!reader.Expect("CHIP") || !reader.Expect("CPU "))
+			return false;
+		size_t index = 0;
+		for (auto peripheral = peripherals.begin(); peripheral != peripherals.end(); ++peripheral)
+			if (!reader.Expect(PeripheralTag(index++).c_str()))
+				return false;
+		if (!memory)
+			return true;
+		size_t ram_size = 0;
+		if (auto ram = QueryInterface<IRam>())
+			for (auto& range : ram->GetRanges())
+				ram_size += range.size;
+		if (!reader.Expect("RAM ", ram_size))
+			return false;
+		// A written flag, then the image if it's set.
+		return (reader.Expect("ROM ", sizeof(bool)) || reader.Expect("ROM ", sizeof(bool) + rom_data.size())) &&
+			   (reader.Expect("FLSH", sizeof(bool)) || reader.Expect("FLSH", sizeof(bool) + flash_data.size()));
+	}
+
+	std::string Chipset::PeripheralTag(size_t index) {
+		// Peripherals are the same ones in the same order for a model, see ConstructPeripherals.
+		char tag[8];
+		snprintf(tag, sizeof(tag), "P%03zu", index);
+		return tag;
+	}
+
 	void Chipset::UIEvent(SDL_Event& event) {
 		for (auto peripheral : peripherals)
 			peripheral->UIEvent(event);
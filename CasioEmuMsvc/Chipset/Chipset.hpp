@@ -3,12 +3,18 @@
 
 #include "InterruptSource.hpp"
 #include "MMURegion.hpp"
+#include "RomImage.hpp"
 
 #include "Peripheral/ExternalInterrupts.hpp"
 #include "Peripheral/IOPorts.hpp"
+#include "Peripheral/Peripheral.hpp"
 
 #include <SDL.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <forward_list>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -17,6 +23,8 @@ namespace casioemu {
 	class CPU;
 	class MMU;
 	class Peripheral;
+	class StateWriter;
+	class StateReader;
 
 	class Chipset {
 		enum InterruptIndex {
@@ -41,16 +49,59 @@ namespace casioemu {
 	private:
 		std::forward_list<Peripheral*> peripherals;
 
+		/**
+		 * Peripherals grouped by `clock_type`, in the same order as `peripherals`, so that a
+		 * clock tick only visits the peripherals it drives. Stopped peripherals are left out.
+		 * Rebuilt lazily after `Peripheral::SetClockType` marks them stale.
+		 */
+		std::vector<Peripheral*> clock_domains[CLOCK_STOPPED];
+		bool clock_domains_dirty;
+		void RebuildClockDomains();
+
 		/**
 		 * A bunch of internally used methods for encapsulation purposes.
 		 */
-		size_t pending_interrupt_count;
-		bool interrupts_active[INT_COUNT];
+		/**
+		 * Raised interrupts, bit `n % 64` of word `n / 64` being interrupt n. Word 0 holds the
+		 * reset, break, emulator, nonmaskable and maskable interrupts, word 1 the software ones,
+		 * so every priority class is a fixed mask and arbitration is a few ANDs and a countr_zero.
+		 */
+		uint64_t interrupts_active[INT_COUNT / 64];
+		static const uint64_t maskable_interrupt_bits = ~((static_cast<uint64_t>(1) << INT_MASKABLE) - 1);
+		bool IsInterruptActive(size_t index) {
+			return (interrupts_active[index / 64] >> (index % 64)) & 1;
+		}
+		void SetInterruptActive(size_t index) {
+			interrupts_active[index / 64] |= static_cast<uint64_t>(1) << (index % 64);
+			interrupts_changed = true;
+		}
+		void ClearInterruptActive(size_t index) {
+			interrupts_active[index / 64] &= ~(static_cast<uint64_t>(1) << (index % 64));
+			interrupts_changed = true;
+		}
+
+		/**
+		 * When AcceptInterrupt leaves every raised interrupt pending (MIE clear, ELEVEL too high or
+		 * MI blocked), the outcome can't change until the raised set or one of those inputs does.
+		 * `interrupts_changed` tracks the former, `interrupt_gate_key` records the latter as seen by
+		 * the last arbitration so Chipset::Tick can skip re-arbitrating.
+		 */
+		bool interrupts_changed;
+		unsigned int interrupt_gate_key;
+		unsigned int GetInterruptGateKey();
+		bool AnyInterruptActive() {
+			return interrupts_active[0] | interrupts_active[1];
+		}
 		void AcceptInterrupt();
 		void RaiseSoftware(size_t index);
 
 		void ConstructPeripherals();
 		void DestructPeripherals();
+		/**
+		 * Initialises or uninitialises the peripherals with a `block_bit` according to BLKCON.
+		 */
+		void ApplyBLKCON();
+		static std::string PeripheralTag(size_t index);
 
 		void ConstructClockGenerator();
 		void GenerateTickForClock();
@@ -72,6 +123,12 @@ namespace casioemu {
 		long long LSCLKTickCounter{}, HSCLKTickCounter, HSCLKTimeCounter, SYSCLKTickCounter, LSCLKTimeCounter, LSCLKThresh;
 		int LSCLKFreqAddition{};
 
+		/**
+		 * SYSCLK cycles per LSCLK period, before the LTBADJ correction in `LSCLKFreqAddition`.
+		 * Only recomputed by `UpdateClockDividers`.
+		 */
+		long long LSCLKPeriod{};
+
 		bool real_hardware;
 
 		void* QueryInterface(const char* name);
@@ -85,8 +142,8 @@ namespace casioemu {
 		CPU& cpu;
 		MMU& mmu;
 
-		std::vector<unsigned char> rom_data;
-		std::vector<unsigned char> flash_data;
+		RomImage rom_data;
+		RomImage flash_data;
 
 		bool remap = false;
 
@@ -134,9 +191,34 @@ namespace casioemu {
 
 		bool isMIBlocked;
 
+		// Performance counters. Only written by the emulation thread.
+		uint64_t ticks_elapsed, instructions_executed;
+
 		// TI things.
 		bool tiDiagMode;
-		int tiKey;
+		std::atomic<int> tiKey;
+
+		/**
+		 * The TI key-read software interrupt suspends the CPU until a key is pressed or half an
+		 * emulated second passes, instead of sleeping on the emulation thread. Peripherals keep
+		 * ticking meanwhile. `ti_key_wait_cycles` is the emulated time left.
+		 */
+		bool ti_key_wait;
+		uint64_t ti_key_wait_cycles;
+		std::mutex ti_key_mutex;
+		std::condition_variable ti_key_cv;
+		void SetTIKey(int key);
+		/**
+		 * Blocks the calling thread for at most `timeout` while the CPU is waiting for a TI key,
+		 * crediting the time spent to the emulated wait. Returns false right away if there's nothing
+		 * left to wait for.
+		 */
+		bool WaitForKey(std::chrono::milliseconds timeout);
+		/**
+		 * Ends a WaitForKey in progress early, so commands posted to the emulator run promptly.
+		 */
+		void InterruptKeyWait();
+		void TickKeyWait();
 
 		/**
 		 * This exists because the Emulator that owns this Chipset is not ready
@@ -164,6 +246,31 @@ namespace casioemu {
 		void InputToPort(int, int, bool);
 		void RemovePortInput(int, int);
 
+		/**
+		 * Recomputes the clock generator dividers. Call after the CPU clock speed or LTBADJ changes.
+		 */
+		void UpdateClockDividers();
+		void InvalidateClockDomains();
+
+		/**
+		 * The whole machine state as save state sections: interrupts and clocks, CPU, one per
+		 * peripheral, then the memory: RAM and the ROM images if they were written to. Call on the
+		 * emulation thread only. The loads return false if a section is missing or damaged, see
+		 * Emulator::LoadState. The core state alone is what RewindBuffer checkpoints besides the
+		 * pages that changed.
+		 */
+		void SaveState(StateWriter& writer);
+		bool LoadState(StateReader& reader);
+		void SaveCoreState(StateWriter& writer);
+		bool LoadCoreState(StateReader& reader);
+		void SaveMemory(StateWriter& writer);
+		bool LoadMemory(StateReader& reader);
+		/**
+		 * Checks what can be checked of the sections before anything is loaded: that they are all
+		 * there and the memory ones have the sizes of this machine.
+		 */
+		bool CheckState(StateReader& reader, bool memory);
+
 		void Tick();
 		void EmulatorTick();
 		void Frame();
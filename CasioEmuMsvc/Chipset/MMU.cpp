@@ -4,23 +4,31 @@
 #include "Chipset.hpp"
 #include "Emulator.hpp"
 #include "Gui/Hooks.h"
-#include "Gui/Ui.hpp"
 #include "Logger.hpp"
+#include <algorithm>
 #include <cstring>
 
 namespace casioemu {
 	MMU::MMU(Emulator& _emulator) : emulator(_emulator) {
 		segment_dispatch = new MemoryByte*[0x100];
-		for (size_t ix = 0; ix != 0x100; ++ix)
+		segment_page_stamps = new uint64_t*[0x100];
+		for (size_t ix = 0; ix != 0x100; ++ix) {
 			segment_dispatch[ix] = nullptr;
+			segment_page_stamps[ix] = nullptr;
+		}
+		write_stamp = 0;
 	}
 
 	MMU::~MMU() {
-		for (size_t ix = 0; ix != 0x100; ++ix)
+		for (size_t ix = 0; ix != 0x100; ++ix) {
 			if (segment_dispatch[ix])
 				delete[] segment_dispatch[ix];
+			if (segment_page_stamps[ix])
+				delete[] segment_page_stamps[ix];
+		}
 
 		delete[] segment_dispatch;
+		delete[] segment_page_stamps;
 	}
 
 	void MMU::GenerateSegmentDispatch(size_t segment_index) {
@@ -28,15 +36,31 @@ namespace casioemu {
 		for (size_t ix = 0; ix != 0x10000; ++ix) {
 			segment_dispatch[segment_index][ix].region = nullptr;
 		}
+		segment_page_stamps[segment_index] = new uint64_t[0x10000 >> page_shift]();
+	}
+
+	uint64_t MMU::GetWriteStamp() {
+		return write_stamp;
+	}
+
+	uint64_t MMU::GetRangeStamp(size_t offset, size_t size) {
+		uint64_t stamp = 0;
+		if (!size)
+			return stamp;
+		for (size_t page = offset >> page_shift; page <= (offset + size - 1) >> page_shift; ++page) {
+			uint64_t* stamps = segment_page_stamps[(page >> (16 - page_shift)) & 0xFF];
+			if (stamps)
+				stamp = std::max(stamp, stamps[page & ((0x10000 >> page_shift) - 1)]);
+		}
+		return stamp;
 	}
 
 	void MMU::SetupInternals() {
-		me_mmu = this;
 		real_hardware = emulator.modeldef.real_hardware;
 	}
 
-	inline uint16_t le_read(uint8_t& a) {
-		return *(uint16_t*)&a;
+	inline uint16_t le_read(const uint8_t& a) {
+		return *(const uint16_t*)&a;
 	}
 
 	uint16_t MMU::ReadCode(size_t offset) {
@@ -112,7 +136,7 @@ namespace casioemu {
 		if (softwareRead) {
 			MemoryEventArgs mea{};
 			mea.offset = static_cast<uint32_t>(offset);
-			RaiseEvent(on_memory_read, *this, mea);
+			RaiseEvent(emulator.hooks.on_memory_read, *this, mea);
 			if (mea.handled)
 				return mea.value;
 		}
@@ -176,7 +200,7 @@ namespace casioemu {
 			MemoryEventArgs mea{};
 			mea.offset = static_cast<uint32_t>(offset);
 			mea.value = data;
-			RaiseEvent(on_memory_write, *this, mea);
+			RaiseEvent(emulator.hooks.on_memory_write, *this, mea);
 			if (mea.handled)
 				return;
 		}
@@ -199,6 +223,7 @@ namespace casioemu {
 			return;
 		}
 		region->write(region, offset, data);
+		segment_page_stamps[segment_index][segment_offset >> page_shift] = ++write_stamp;
 	}
 
 	size_t MMU::getRealOffset(size_t offset) {
@@ -24,7 +24,17 @@ namespace casioemu
 		};
 		MemoryByte **segment_dispatch;
 		std::vector<MMURegion*> regions;
+
+		/**
+		 * Write tracking. Every data write that reaches a region stamps its 256 byte page with the
+		 * next value of `write_stamp`, so a range was written since stamp X iff GetRangeStamp > X.
+		 * Peripherals that change their own buffers directly (not through WriteData) aren't seen.
+		 */
+		uint64_t write_stamp;
+		uint64_t **segment_page_stamps;
 	public:
+		static const size_t page_shift = 8;
+
 		MMU(Emulator &emulator);
 		~MMU();
 		void SetupInternals();
@@ -34,6 +44,12 @@ namespace casioemu
 		void WriteData(size_t offset, uint8_t data, bool softwareWrite = true);
 		size_t getRealOffset(size_t offset);
 
+		uint64_t GetWriteStamp();
+		/**
+		 * Latest write stamp among the pages overlapping [offset, offset + size), 0 if never written.
+		 */
+		uint64_t GetRangeStamp(size_t offset, size_t size);
+
 
 		std::vector<MMURegion*> GetRegions();
 		void RegisterRegion(MMURegion *region);
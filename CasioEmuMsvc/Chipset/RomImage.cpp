@@ -0,0 +1,135 @@
+﻿#include "RomImage.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace casioemu {
+	static std::mutex images_mutex;
+	struct SharedImage {
+		std::weak_ptr<const uint8_t> data;
+		size_t size;
+	};
+	static std::map<std::string, SharedImage> images;
+
+	RomImage::RomImage(const RomImage& other) : shared(other.shared), copy(other.copy), length(other.length), write_stamp(other.write_stamp), page_stamps(other.page_stamps) {
+		bytes = other.IsShared() ? other.bytes : copy.data();
+	}
+
+	RomImage& RomImage::operator=(const RomImage& other) {
+		if (this != &other) {
+			shared = other.shared;
+			copy = other.copy;
+			length = other.length;
+			write_stamp = other.write_stamp;
+			page_stamps = other.page_stamps;
+			bytes = other.IsShared() ? other.bytes : copy.data();
+		}
+		return *this;
+	}
+
+	RomImage RomImage::Share(const std::string& key, const Loader& load) {
+		RomImage image;
+		std::lock_guard<std::mutex> lock(images_mutex);
+		auto& slot = images[key];
+		image.shared = slot.data.lock();
+		if (!image.shared) {
+			auto buffer = load();
+			slot.data = image.shared = buffer.data;
+			slot.size = buffer.size;
+		}
+		image.length = slot.size;
+		image.bytes = image.shared.get();
+		return image;
+	}
+
+	RomImage::Buffer RomImage::LoadFile(const std::string& path, size_t min_size, uint8_t fill) {
+		Buffer buffer;
+#ifdef _WIN32
+		std::ifstream handle(path, std::ifstream::binary | std::ifstream::ate);
+		if (handle.fail())
+			PANIC("std::ifstream failed: %s\n", std::strerror(errno));
+		size_t file_size = handle.tellg();
+		size_t buffer_size = std::max(file_size, min_size);
+		buffer.data.reset(new uint8_t[buffer_size], std::default_delete<uint8_t[]>());
+		handle.seekg(0);
+		if (!handle.read((char*)buffer.data.get(), file_size))
+			PANIC("std::ifstream failed: %s\n", std::strerror(errno));
+		std::fill(buffer.data.get() + file_size, buffer.data.get() + buffer_size, fill);
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) < 0)
+			PANIC("open failed: %s\n", std::strerror(errno));
+		size_t file_size = st.st_size;
+		size_t buffer_size = std::max(file_size, min_size);
+		// Reserve the whole buffer as anonymous memory, then map the file over its start. Both are
+		// private, so writes (patches, padding past the end of the file) only copy the pages touched.
+		size_t page = sysconf(_SC_PAGESIZE);
+		size_t mapped_size = (std::max<size_t>(buffer_size, 1) + page - 1) / page * page;
+		auto base = (uint8_t*)mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED)
+			PANIC("mmap failed: %s\n", std::strerror(errno));
+		if (file_size && mmap(base, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+			PANIC("mmap failed: %s\n", std::strerror(errno));
+		close(fd);
+		if (fill)
+			std::fill(base + file_size, base + buffer_size, fill);
+		buffer.data.reset(base, [mapped_size](uint8_t* p) { munmap(p, mapped_size); });
+#endif
+		buffer.size = file_size;
+		return buffer;
+	}
+
+	uint64_t RomImage::GetRangeStamp(size_t offset, size_t size) const {
+		uint64_t stamp = 0;
+		if (!size || offset >= length)
+			return stamp;
+		size_t last = offset + std::min(size, length - offset) - 1;
+		for (size_t page = offset >> page_shift; page <= last >> page_shift && page < page_stamps.size(); ++page)
+			stamp = std::max(stamp, page_stamps[page]);
+		return stamp;
+	}
+
+	void RomImage::Stamp(size_t offset, size_t size) {
+		if (page_stamps.empty())
+			page_stamps.resize((length + ((size_t)1 << page_shift) - 1) >> page_shift);
+		++write_stamp;
+		if (!size || offset >= length)
+			return;
+		size_t last = offset + std::min(size, length - offset) - 1;
+		for (size_t page = offset >> page_shift; page <= last >> page_shift; ++page)
+			page_stamps[page] = write_stamp;
+	}
+
+	uint8_t* RomImage::MakeWritable(size_t offset, size_t size) {
+		if (IsShared()) {
+			// Reuse the buffer a Discard left behind, its address must not change under readers.
+			if (copy.size() == length)
+				std::copy(bytes, bytes + length, copy.begin());
+			else
+				copy.assign(bytes, bytes + length);
+			bytes = copy.data();
+		}
+		Stamp(offset, size);
+		return copy.data();
+	}
+
+	void RomImage::Discard() {
+		if (!shared || IsShared())
+			return;
+		bytes = shared.get();
+		Stamp(0, length);
+	}
+} // namespace casioemu
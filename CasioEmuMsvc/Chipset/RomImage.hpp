@@ -0,0 +1,103 @@
+﻿#pragma once
+#include "Config.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace casioemu {
+	/**
+	 * A ROM or flash image. Every instance that loads the same file shares one read-only copy of
+	 * the bytes; the first MakeWritable (firmware flashing, a debugger edit) gives this instance
+	 * a private copy. Neither is freed while the instance lives: the shared bytes stay alive after
+	 * MakeWritable, and the private copy after Discard (a later MakeWritable reuses it). So a reader
+	 * on another thread, such as the hex editor, may hold a stale data() pointer but never a dangling
+	 * one.
+	 */
+	class RomImage {
+	public:
+		struct Buffer {
+			std::shared_ptr<uint8_t> data;
+			size_t size = 0;
+		};
+		typedef std::function<Buffer()> Loader;
+
+	private:
+		std::shared_ptr<const uint8_t> shared;
+		std::vector<uint8_t> copy;
+		const uint8_t* bytes = nullptr;
+		size_t length = 0;
+		uint64_t write_stamp = 0;
+		std::vector<uint64_t> page_stamps; // allocated by the first MakeWritable
+		void Stamp(size_t offset, size_t size);
+
+	public:
+		RomImage() = default;
+		RomImage(const RomImage& other);
+		RomImage& operator=(const RomImage& other);
+
+		/**
+		 * Returns the image cached under `key`, or calls `load` to build it if no instance holds
+		 * one at the moment. Whatever `load` does to the bytes (padding, patches) is shared too,
+		 * so it must only depend on `key`.
+		 */
+		static RomImage Share(const std::string& key, const Loader& load);
+
+		/**
+		 * Loads a whole file into a writable buffer of at least `min_size` bytes, the rest filled
+		 * with `fill`. The returned size is the file's. On POSIX systems the file is mapped copy-on-write rather than read, so only
+		 * the pages that are touched get loaded and they come straight from the page cache.
+		 * Elsewhere it is one bulk read. PANICs if the file can't be read.
+		 */
+		static Buffer LoadFile(const std::string& path, size_t min_size = 0, uint8_t fill = 0);
+
+		const uint8_t* data() const {
+			return bytes;
+		}
+		size_t size() const {
+			return length;
+		}
+		bool empty() const {
+			return !length;
+		}
+		const uint8_t& operator[](size_t index) const {
+			return bytes[index];
+		}
+
+		/**
+		 * The bytes as loaded, before any MakeWritable changes.
+		 */
+		const uint8_t* Original() const {
+			return shared ? shared.get() : bytes;
+		}
+		bool IsShared() const {
+			return shared && bytes == shared.get();
+		}
+		/**
+		 * Write tracking, like MMU's for RAM: MakeWritable and Discard stamp the 256 byte pages they
+		 * cover with the next value of `write_stamp`, so a range changed since stamp X iff
+		 * GetRangeStamp > X.
+		 */
+		static const size_t page_shift = 8;
+		uint64_t GetWriteStamp() const {
+			return write_stamp;
+		}
+		/**
+		 * Latest write stamp among the pages overlapping [offset, offset + size), 0 if never written.
+		 */
+		uint64_t GetRangeStamp(size_t offset, size_t size) const;
+
+		/**
+		 * Detaches this instance from the shared image, copying it on the first call, and returns
+		 * the start of the private copy. The caller may only change [offset, offset + size), which
+		 * is the range stamped as written.
+		 */
+		uint8_t* MakeWritable(size_t offset = 0, size_t size = (size_t)-1);
+		/**
+		 * Goes back to the shared image. The private copy, if any, is kept for the next MakeWritable.
+		 */
+		void Discard();
+	};
+} // namespace casioemu
@@ -0,0 +1,51 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+/**
+ * Single writer sequence lock around a trivially copyable value. `Store` never waits; `Load`
+ * copies the value and retries if a store overlapped the copy, so readers never hold the writer
+ * up. The sequence is odd while a store is in progress.
+ */
+template <class T>
+class SeqLock {
+	static_assert(std::is_trivially_copyable_v<T>, "SeqLock needs a trivially copyable value");
+
+	std::atomic<uint32_t> sequence{0};
+	T value{};
+
+public:
+	void Store(const T& src) {
+		auto seq = sequence.load(std::memory_order_relaxed);
+		sequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(&value, &src, sizeof(T));
+		sequence.store(seq + 2, std::memory_order_release);
+	}
+	void Load(T& dst) const {
+		while (1) {
+			auto seq = sequence.load(std::memory_order_acquire);
+			if (seq & 1) {
+				std::this_thread::yield();
+				continue;
+			}
+			std::memcpy(&dst, &value, sizeof(T));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (sequence.load(std::memory_order_relaxed) == seq)
+				return;
+		}
+	}
+	T Load() const {
+		T dst;
+		Load(dst);
+		return dst;
+	}
+	/**
+	 * Number of completed stores, for readers that only want to copy when something changed.
+	 */
+	uint32_t GetVersion() const {
+		return sequence.load(std::memory_order_acquire) / 2;
+	}
+};
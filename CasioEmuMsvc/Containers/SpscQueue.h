@@ -0,0 +1,44 @@
+﻿#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+/**
+ * Bounded single producer, single consumer queue. `Push` is only called by the producer thread
+ * and `Pop` only by the consumer; neither ever waits, so the consumer can drain it from a hot
+ * loop. The producer decides what to do when the queue is full.
+ */
+template <class T, size_t Capacity>
+class SpscQueue {
+	static_assert(Capacity && !(Capacity & (Capacity - 1)), "SpscQueue capacity must be a power of two");
+
+	T slots[Capacity];
+	// Written by the consumer, read by the producer.
+	alignas(64) std::atomic<size_t> head{0};
+	// Written by the producer, read by the consumer.
+	alignas(64) std::atomic<size_t> tail{0};
+
+public:
+	/**
+	 * Moves `value` into the queue. Returns false, leaving `value` untouched, if the queue is full.
+	 */
+	bool Push(T&& value) {
+		auto t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == Capacity)
+			return false;
+		slots[t % Capacity] = std::move(value);
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+	bool Pop(T& value) {
+		auto h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+		value = std::move(slots[h % Capacity]);
+		slots[h % Capacity] = T{};
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+	bool Empty() const {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+};
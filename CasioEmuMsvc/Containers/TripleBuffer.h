@@ -0,0 +1,42 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+/**
+ * Single producer, single consumer triple buffer. The producer fills `WriteBuffer()` and calls
+ * `Publish()`, the consumer calls `Acquire()` and reads `ReadBuffer()`, which then holds the
+ * newest published value. Neither side ever blocks: each owns one slot and they only trade
+ * slots with the third one through a single atomic exchange, so a slot is never read while
+ * it's being written. Values published while the consumer isn't looking are dropped.
+ */
+template <class T>
+class TripleBuffer {
+	static const uint8_t index_mask = 3;
+	static const uint8_t fresh_bit = 4;
+
+	T buffers[3]{};
+	// Index of the slot in the middle, plus `fresh_bit` if it holds a value not acquired yet.
+	std::atomic<uint8_t> middle{2};
+	uint8_t back = 0, front = 1;
+
+public:
+	T& WriteBuffer() {
+		return buffers[back];
+	}
+	void Publish() {
+		back = middle.exchange(back | fresh_bit, std::memory_order_acq_rel) & index_mask;
+	}
+
+	/**
+	 * Moves the newest published value into `ReadBuffer()`. Returns false, keeping the
+	 * current one, if nothing was published since the last call.
+	 */
+	bool Acquire() {
+		if (!(middle.load(std::memory_order_relaxed) & fresh_bit))
+			return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+		return true;
+	}
+	const T& ReadBuffer() const {
+		return buffers[front];
+	}
+};
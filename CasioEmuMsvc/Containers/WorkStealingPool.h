@@ -0,0 +1,107 @@
+﻿#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+/**
+ * Fixed set of worker threads, each with its own job deque. A worker takes jobs from the back of
+ * its own deque and steals from the front of the others' once it runs dry, so uneven jobs still
+ * keep every thread busy. Meant for coarse jobs, so every deque simply has its own mutex.
+ */
+class WorkStealingPool {
+	struct Worker {
+		std::mutex mutex;
+		std::deque<std::function<void()>> jobs;
+	};
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<std::thread> threads;
+	std::atomic<size_t> pending{0}, next_worker{0};
+	bool stopping = false;
+	std::mutex idle_mutex;
+	std::condition_variable idle_cv;
+
+	bool TryTake(size_t self, std::function<void()>& job) {
+		{
+			auto& own = *workers[self];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.jobs.empty()) {
+				job = std::move(own.jobs.back());
+				own.jobs.pop_back();
+				return true;
+			}
+		}
+		for (size_t i = 1; i != workers.size(); ++i) {
+			auto& victim = *workers[(self + i) % workers.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.jobs.empty()) {
+				job = std::move(victim.jobs.front());
+				victim.jobs.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+	void WorkerLoop(size_t self) {
+		while (1) {
+			std::function<void()> job;
+			if (TryTake(self, job)) {
+				job();
+				if (--pending == 0) {
+					std::lock_guard<std::mutex> lock(idle_mutex);
+					idle_cv.notify_all();
+				}
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(idle_mutex);
+			if (stopping)
+				return;
+			// Submit notifies, the timeout only covers a job pushed between TryTake and here.
+			idle_cv.wait_for(lock, std::chrono::milliseconds(10));
+		}
+	}
+
+public:
+	explicit WorkStealingPool(size_t thread_count = std::thread::hardware_concurrency()) {
+		thread_count = std::max<size_t>(thread_count, 1);
+		for (size_t i = 0; i != thread_count; ++i)
+			workers.push_back(std::make_unique<Worker>());
+		for (size_t i = 0; i != thread_count; ++i)
+			threads.emplace_back([this, i] { WorkerLoop(i); });
+	}
+	~WorkStealingPool() {
+		Wait();
+		{
+			std::lock_guard<std::mutex> lock(idle_mutex);
+			stopping = true;
+		}
+		idle_cv.notify_all();
+		for (auto& thread : threads)
+			thread.join();
+	}
+	void Submit(std::function<void()> job) {
+		++pending;
+		auto& worker = *workers[next_worker++ % workers.size()];
+		{
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			worker.jobs.push_back(std::move(job));
+		}
+		std::lock_guard<std::mutex> lock(idle_mutex);
+		idle_cv.notify_all();
+	}
+	/**
+	 * Blocks until every submitted job has finished.
+	 */
+	void Wait() {
+		std::unique_lock<std::mutex> lock(idle_mutex);
+		idle_cv.wait(lock, [this] { return pending == 0; });
+	}
+	size_t Size() const {
+		return threads.size();
+	}
+};
@@ -1,23 +1,35 @@
 ﻿#include "Emulator.hpp"
 
+#include "BootCache.hpp"
+#include "Chipset/CPU.hpp"
 #include "Chipset/Chipset.hpp"
 #include "Logger.hpp"
+#include "RewindBuffer.hpp"
+#include "SaveState.hpp"
 
 #include "ModelInfo.h"
 #include <cassert>
 #include <chrono>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <sstream>
 #include <string>
 
 namespace casioemu {
+	/**
+	 * Interval of the EMUCLK tick (`Chipset::EmulatorTick`) used by the non-real-hardware models, in milliseconds.
+	 */
+	static const unsigned int emulator_tick_interval = 25;
+
 	Emulator::Emulator(std::map<std::string, std::string>& _argv_map, bool _paused) : paused(_paused), argv_map(_argv_map), chipset(*new Chipset(*this)) {
 		// std::lock_guard<decltype(access_mx)> access_lock(access_mx);
 
 		running = true;
 		model_path = argv_map["model"];
+		headless = argv_map.find("headless") != argv_map.end();
 
 		LoadModelDefition();
 
@@ -34,8 +46,12 @@ namespace casioemu {
 			cycles_per_second = 1024 * 1024 * 8;
 		}
 		timer_interval = 20;
+		emulated_seconds_base = 0;
+		emulated_ticks_base = 0;
 
 		cycles.Setup(cycles_per_second, timer_interval);
+		auto seed_iter = argv_map.find("seed");
+		random_seed = seed_iter != argv_map.end() ? (unsigned int)std::strtoul(seed_iter->second.c_str(), nullptr, 0) : headless ? 0 : (unsigned int)SDL_GetPerformanceCounter();
 		chipset.Setup();
 
 		BatteryVoltage = 1.5;
@@ -70,26 +86,68 @@ namespace casioemu {
 		catch (std::out_of_range const&) {
 			PANIC("out of range width/height parameter\n");
 		}
-		SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "best");
-		window = SDL_CreateWindow(
-			std::string(modeldef.model_name).c_str(),
-			SDL_WINDOWPOS_UNDEFINED,
-			SDL_WINDOWPOS_UNDEFINED,
-			width, height,
-			SDL_WINDOW_SHOWN | (SDL_WINDOW_RESIZABLE));
-		if (!window)
-			PANIC("SDL_CreateWindow failed: %s\n", SDL_GetError());
-		renderer = SDL_CreateRenderer(window, -1, 0);
-		if (!renderer)
-			PANIC("SDL_CreateRenderer failed: %s\n", SDL_GetError());
+		window = nullptr;
+		renderer = nullptr;
+		interface_texture = nullptr;
+		if (!headless) {
+			SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "best");
+			window = SDL_CreateWindow(
+				std::string(modeldef.model_name).c_str(),
+				SDL_WINDOWPOS_UNDEFINED,
+				SDL_WINDOWPOS_UNDEFINED,
+				width, height,
+				SDL_WINDOW_SHOWN | (SDL_WINDOW_RESIZABLE));
+			if (!window)
+				PANIC("SDL_CreateWindow failed: %s\n", SDL_GetError());
+			renderer = SDL_CreateRenderer(window, -1, 0);
+			if (!renderer)
+				PANIC("SDL_CreateRenderer failed: %s\n", SDL_GetError());
+		}
 
+		// Still needed headless, the screen takes its pixel sprite from it.
 		interface_surface = IMG_Load(GetModelFilePath(modeldef.interface_path).c_str());
 		if (!interface_surface)
 			PANIC("IMG_Load failed: %s\n", IMG_GetError());
-		interface_texture = SDL_CreateTextureFromSurface(renderer, interface_surface);
+		if (!headless)
+			interface_texture = SDL_CreateTextureFromSurface(renderer, interface_surface);
 
 		SetupInternals();
 		cycles.Reset();
+
+		if (headless) {
+			// The peripherals have copied what they need.
+			SDL_FreeSurface(interface_surface);
+			interface_surface = nullptr;
+		}
+
+		turbo = argv_map.find("turbo") != argv_map.end();
+		mips = 0;
+		speed_multiple = 0;
+		command_latency = 0;
+		command_latency_max = 0;
+		stats_last_time = std::chrono::steady_clock::now();
+		stats_last_ticks = stats_last_instructions = 0;
+
+		try {
+			// Only the GUI and its debugger rewind, headless runs ask for it explicitly.
+			size_t rewind_megabytes = headless ? 0 : 32;
+			unsigned long rewind_interval = 100;
+			auto rewind_iter = argv_map.find("rewind");
+			if (rewind_iter != argv_map.end())
+				rewind_megabytes = std::stoul(rewind_iter->second);
+			auto rewind_interval_iter = argv_map.find("rewind_interval");
+			if (rewind_interval_iter != argv_map.end())
+				rewind_interval = std::stoul(rewind_interval_iter->second);
+			if (rewind_megabytes)
+				rewind = std::make_unique<RewindBuffer>(*this, rewind_megabytes << 20, (unsigned int)rewind_interval);
+		}
+		catch (std::invalid_argument const&) {
+			PANIC("invalid rewind/rewind_interval parameter\n");
+		}
+		catch (std::out_of_range const&) {
+			PANIC("out of range rewind/rewind_interval parameter\n");
+		}
+
 		if (modeldef.real_hardware) {
 			tick_thread = new std::thread([this] {
 				auto iteration_end = std::chrono::steady_clock::now();
@@ -98,43 +156,100 @@ namespace casioemu {
 						// std::lock_guard<decltype(access_mx)> access_lock(access_mx);
 						if (!Running())
 							break;
+						bool commands_ran = RunCommands();
+						if (rewind)
+							rewind->Poll(commands_ran);
 						TimerCallback();
+						if (boot_cache)
+							boot_cache->Poll();
+						chipset.cpu.PublishSnapshot();
+						UpdatePerformanceStats();
 					}
 
 					iteration_end += std::chrono::milliseconds(timer_interval);
 					auto now = std::chrono::steady_clock::now();
-					if (iteration_end > now)
+					if (turbo && !paused) // run the next interval straight away
+						iteration_end = now;
+					else if (paused) { // nothing to emulate, only a command can change that
+						WaitForCommands(std::chrono::milliseconds(timer_interval));
+						iteration_end = std::chrono::steady_clock::now();
+					}
+					else if (iteration_end > now)
 						std::this_thread::sleep_until(iteration_end);
-					else // in case the computer is not fast enough or paused
+					else // in case the computer is not fast enough
 						iteration_end = now;
 				}
+				run_done.reset();
 			});
 		}
 		else {
 			tick_thread = new std::thread([this] {
-				while (1) {
-					{
-						if (!Running())
-							break;
-						if (!paused)
+				auto emulator_tick_last = std::chrono::steady_clock::now();
+				for (Uint64 iteration = 1;; ++iteration) {
+					if (!Running())
+						break;
+					bool idle = false;
+					if (paused) {
+						WaitForCommands(std::chrono::milliseconds(emulator_tick_interval));
+						idle = true;
+					}
+					else {
+						// Nothing to run while the TI firmware waits for a key, sleep until one arrives instead of spinning.
+						if (!turbo && chipset.WaitForKey(std::chrono::milliseconds(emulator_tick_interval))) {
+							idle = true;
+							if (rewind)
+								rewind->NoteKeyWait();
+						}
+						else
 							Tick();
+						// In turbo mode the EMUCLK tick follows emulated cycles instead of the host clock.
+						if (turbo && ++emulator_tick_cycles >= (Uint64)GetCyclesPerSecond() * emulator_tick_interval / 1000) {
+							emulator_tick_cycles = 0;
+							EmulatorTick();
+						}
+					}
+					if (!idle && iteration % 4096)
+						continue;
+					auto now = std::chrono::steady_clock::now();
+					if (!turbo && !paused && now - emulator_tick_last >= std::chrono::milliseconds(emulator_tick_interval)) {
+						emulator_tick_last = now;
+						EmulatorTick();
 					}
+					bool commands_ran = RunCommands();
+					if (rewind)
+						rewind->Poll(commands_ran);
+					if (boot_cache)
+						boot_cache->Poll();
+					chipset.cpu.PublishSnapshot();
+					UpdatePerformanceStats();
 				}
+				run_done.reset();
 			});
-			SDL_AddTimer(
-				25,
-				[](Uint32 interval, void* param) -> Uint32 {
-					auto emu = ((Emulator*)param);
-					emu->chipset.EmulatorTick();
-					return interval;
-				},
-				this);
 		}
 
 		RunStartupScript();
 
 		chipset.Reset();
 
+		auto state_iter = argv_map.find("state");
+		auto boot_cache_iter = argv_map.find("boot_cache");
+		if (state_iter != argv_map.end()) {
+			// A state that fails to load leaves the machine booting from the reset above.
+			Call([this, path = state_iter->second] { LoadStateFile(path); }).wait();
+		}
+		else if (boot_cache_iter != argv_map.end()) {
+			if (argv_map.find("ram") != argv_map.end() && argv_map.find("clean_ram") == argv_map.end()) {
+				logger::Info("[BootCache][Info] Not used with a RAM image\n");
+			}
+			else {
+				auto cache = new BootCache(*this, boot_cache_iter->second);
+				booted_from_cache = Call([this, cache] {
+					boot_cache.reset(cache);
+					return cache->Restore();
+				}).get();
+			}
+		}
+
 		if (argv_map.find("paused") != argv_map.end())
 			SetPaused(true);
 
@@ -148,9 +263,12 @@ namespace casioemu {
 
 		// std::lock_guard<decltype(access_mx)> access_lock(access_mx);
 
-		SDL_DestroyTexture(interface_texture);
-		SDL_DestroyRenderer(renderer);
-		SDL_DestroyWindow(window);
+		if (!headless) {
+			DestroyFrameTexture();
+			SDL_DestroyTexture(interface_texture);
+			SDL_DestroyRenderer(renderer);
+			SDL_DestroyWindow(window);
+		}
 
 		delete &chipset;
 	}
@@ -166,6 +284,11 @@ namespace casioemu {
 		// std::lock_guard<decltype(access_mx)> access_lock(access_mx);
 
 		switch (event.type) {
+		case SDL_RENDER_TARGETS_RESET:
+		case SDL_RENDER_DEVICE_RESET:
+			// Contents of target textures are lost, start from a fresh one.
+			DestroyFrameTexture();
+			return;
 		case SDL_MOUSEBUTTONDOWN:
 		case SDL_MOUSEBUTTONUP:
 			event.button.x -= emu_rect.x;
@@ -187,8 +310,58 @@ namespace casioemu {
 			event.tfinger.y *= (float)interface_background.dest.h / emu_rect.h;
 			break;
 		}
+		case SDL_KEYDOWN:
+		case SDL_KEYUP:
+			break;
+		default:
+			// Nothing in the chipset handles it, don't cost the rewind buffer a checkpoint.
+			return;
+		}
+		Post([this, event]() mutable { chipset.UIEvent(event); });
+	}
+
+	void Emulator::Post(std::function<void()> command, bool changes_state) {
+		if (tick_thread && std::this_thread::get_id() == tick_thread->get_id()) {
+			command();
+			return;
+		}
+		// Nobody would run it anymore.
+		if (!Running())
+			return;
+		Command queued{std::move(command), std::chrono::steady_clock::now(), changes_state};
+		// The queue only fills up if the tick thread is stuck; give it a moment rather than drop input.
+		while (!commands.Push(std::move(queued))) {
+			if (!Running())
+				return;
+			std::this_thread::yield();
+		}
+		chipset.InterruptKeyWait();
+		{
+			std::lock_guard<std::mutex> lock(command_mutex);
+		}
+		command_cv.notify_one();
+	}
+
+	void Emulator::WaitForCommands(std::chrono::milliseconds timeout) {
+		std::unique_lock<std::mutex> lock(command_mutex);
+		command_cv.wait_for(lock, timeout, [this] { return !commands.Empty(); });
+	}
+
+	bool Emulator::HasPendingCommands() {
+		return !commands.Empty();
+	}
+
+	bool Emulator::RunCommands() {
+		Command command;
+		bool changed = false;
+		while (commands.Pop(command)) {
+			changed |= command.changes_state;
+			double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - command.posted).count();
+			if (latency > command_latency_max)
+				command_latency_max = latency;
+			command.run();
 		}
-		chipset.UIEvent(event);
+		return changed;
 	}
 
 	void Emulator::RunStartupScript() {
@@ -203,6 +376,27 @@ namespace casioemu {
 		chipset.SetupInternals();
 	}
 
+	uint64_t Emulator::GetModelHash() {
+		if (model_hash_ready)
+			return model_hash;
+		// FNV-1a
+		uint64_t hash = 0xcbf29ce484222325;
+		auto mix = [&](const uint8_t* data, size_t size) {
+			for (size_t i = 0; i != size; ++i) {
+				hash ^= data[i];
+				hash *= 0x100000001b3;
+			}
+		};
+		mix(chipset.rom_data.Original(), chipset.rom_data.size());
+		mix(chipset.flash_data.Original(), chipset.flash_data.size());
+		std::ifstream config(GetModelFilePath("config.bin"), std::ifstream::binary);
+		std::string config_data((std::istreambuf_iterator<char>(config)), std::istreambuf_iterator<char>());
+		mix((const uint8_t*)config_data.data(), config_data.size());
+		model_hash = hash;
+		model_hash_ready = true;
+		return model_hash;
+	}
+
 	void Emulator::LoadModelDefition() {
 		std::ifstream ifs(GetModelFilePath("config.bin"), std::ios::in | std::ios::binary);
 		if (!ifs.good())
@@ -236,13 +430,21 @@ namespace casioemu {
 	void Emulator::Frame() {
 		// std::lock_guard<decltype(access_mx)> access_lock(access_mx);
 
-		// create texture `tx` with the same format as `interface_texture`
-		Uint32 format;
-		SDL_QueryTexture(interface_texture, &format, nullptr, nullptr, nullptr);
-		SDL_Texture* tx = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_TARGET, interface_background.dest.w, interface_background.dest.h);
+		// (re)create `frame_texture` with the same format as `interface_texture` if needed
+		if (frame_texture && (frame_texture_width != interface_background.dest.w || frame_texture_height != interface_background.dest.h))
+			DestroyFrameTexture();
+		if (!frame_texture) {
+			Uint32 format;
+			SDL_QueryTexture(interface_texture, &format, nullptr, nullptr, nullptr);
+			frame_texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_TARGET, interface_background.dest.w, interface_background.dest.h);
+			if (!frame_texture)
+				PANIC("SDL_CreateTexture failed: %s\n", SDL_GetError());
+			frame_texture_width = interface_background.dest.w;
+			frame_texture_height = interface_background.dest.h;
+		}
 
-		// render on `tx`
-		SDL_SetRenderTarget(renderer, tx);
+		// render on `frame_texture`
+		SDL_SetRenderTarget(renderer, frame_texture);
 		SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
 		SDL_RenderClear(renderer);
 		SDL_SetTextureColorMod(interface_texture, 255, 255, 255);
@@ -250,7 +452,7 @@ namespace casioemu {
 		SDL_RenderCopy(renderer, interface_texture, &interface_background.src, nullptr);
 		chipset.Frame();
 
-		// resize and copy `tx` to screen
+		// resize and copy `frame_texture` to screen
 		SDL_SetRenderTarget(renderer, nullptr);
 		int w, h;
 		SDL_GetWindowSize(window, &w, &h);
@@ -262,17 +464,55 @@ namespace casioemu {
 		dest.h = interface_background.src.h * uf;
 		dest.x = (w - dest.w) / 2;
 		dest.y = (h - dest.h) / 2; // Centre it
-		SDL_RenderCopy(renderer, tx, nullptr, &dest);
+		SDL_RenderCopy(renderer, frame_texture, nullptr, &dest);
 		emu_rect = dest;
-		SDL_DestroyTexture(tx);
 		Repaint();
 	}
 
+	void Emulator::DestroyFrameTexture() {
+		if (frame_texture)
+			SDL_DestroyTexture(frame_texture);
+		frame_texture = nullptr;
+	}
+
 	void Emulator::WindowResize(int _width, int _height) {
 	}
 
 	void Emulator::Tick() {
 		chipset.Tick();
+		if (run_done && !--run_ticks_left)
+			FinishRun();
+	}
+
+	std::future<void> Emulator::RunFor(Uint64 ticks) {
+		auto done = std::make_shared<std::promise<void>>();
+		auto result = done->get_future();
+		Post([this, ticks, done] {
+			if (run_done)
+				FinishRun();
+			run_done = done;
+			run_ticks_left = ticks;
+			paused = false;
+			if (!ticks)
+				FinishRun();
+		}, false);
+		return result;
+	}
+
+	void Emulator::FinishRun() {
+		paused = true;
+		run_done->set_value();
+		run_done.reset();
+	}
+
+	unsigned int Emulator::NextRandomSeed() {
+		return random_seed++;
+	}
+
+	void Emulator::EmulatorTick() {
+		if (rewind)
+			rewind->NoteEmulatorTick();
+		chipset.EmulatorTick();
 	}
 
 	bool Emulator::Running() {
@@ -296,6 +536,34 @@ namespace casioemu {
 		paused = _paused;
 	}
 
+	bool Emulator::GetTurbo() {
+		return turbo;
+	}
+
+	void Emulator::SetTurbo(bool _turbo) {
+		turbo = _turbo;
+	}
+
+	void Emulator::UpdatePerformanceStats() {
+		auto now = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration<double>(now - stats_last_time).count();
+		if (elapsed < 1.0)
+			return;
+
+		Uint64 ticks = chipset.ticks_elapsed, instructions = chipset.instructions_executed;
+		mips = (instructions - stats_last_instructions) / elapsed / 1e6;
+		speed_multiple = (ticks - stats_last_ticks) / elapsed / GetCyclesPerSecond();
+		stats_last_time = now;
+		stats_last_ticks = ticks;
+		stats_last_instructions = instructions;
+		command_latency = command_latency_max;
+		command_latency_max = 0;
+
+		// Headless runs (batch workers among them) report through their own output, not stdout.
+		if (turbo && !paused && !headless)
+			printf("[Emulator][Info] %.2f MIPS, %.2fx speed\n", mips.load(), speed_multiple.load());
+	}
+
 	void Emulator::Cycles::Setup(Uint64 _cycles_per_second, unsigned int _timer_interval) {
 		ticks_now = 0;
 		cycles_emulated = 0;
@@ -329,7 +597,94 @@ namespace casioemu {
 	}
 
 	void Emulator::SetClockSpeed(float speed) {
-		cycles.Setup((unsigned int)(cycles_per_second * speed), timer_interval);
+		SetCyclesPerSecond((Uint64)(cycles_per_second * speed));
+	}
+
+	void Emulator::SetCyclesPerSecond(Uint64 cps) {
+		emulated_seconds_base = GetEmulatedSeconds();
+		emulated_ticks_base = chipset.ticks_elapsed;
+		cycles.Setup(cps, timer_interval);
+		chipset.UpdateClockDividers();
+	}
+
+	double Emulator::GetEmulatedSeconds() {
+		return emulated_seconds_base + (double)(chipset.ticks_elapsed - emulated_ticks_base) / GetCyclesPerSecond();
+	}
+
+	void Emulator::SaveState(std::ostream& os, bool memory) {
+		StateWriter writer(os, memory ? GetModelHash() : 0);
+		writer.Section("EMU ", [&](std::ostream& os) {
+			Binary::WriteAll(os, GetEmulatedSeconds(), cycles.cycles_per_second, modeldef.pd_value);
+		});
+		chipset.SaveCoreState(writer);
+		if (memory)
+			chipset.SaveMemory(writer);
+		writer.End();
+	}
+
+	bool Emulator::LoadState(std::istream& is, bool memory) {
+		StateReader reader;
+		double seconds;
+		Uint64 cps = 0;
+		uint8_t pd;
+		if (!reader.Open(is, memory ? GetModelHash() : 0) || !reader.Section("EMU ", [&](std::istream& is) { Binary::ReadAll(is, seconds, cps, pd); }) || !chipset.CheckState(reader, memory)) {
+			logger::Info("[SaveState][Error] Cannot load state: %s\n", reader.Error().c_str());
+			return false;
+		}
+		if (!cps) {
+			logger::Info("[SaveState][Error] Cannot load state: damaged section EMU \n");
+			return false;
+		}
+		if (!memory)
+			return LoadSections(reader, seconds, cps, pd, memory);
+
+		// A peripheral section can still turn out damaged half way, go back to the machine as it was then.
+		std::stringstream backup;
+		SaveState(backup);
+		if (LoadSections(reader, seconds, cps, pd, memory)) {
+			if (rewind)
+				rewind->Clear();
+			return true;
+		}
+		logger::Info("[SaveState][Error] Cannot load state: %s\n", reader.Error().c_str());
+		StateReader previous;
+		previous.Open(backup, GetModelHash());
+		previous.Section("EMU ", [&](std::istream& is) { Binary::ReadAll(is, seconds, cps, pd); });
+		LoadSections(previous, seconds, cps, pd, memory);
+		return false;
+	}
+
+	bool Emulator::LoadSections(StateReader& reader, double seconds, Uint64 cps, uint8_t pd, bool memory) {
+		cycles.Setup(cps, timer_interval);
+		emulator_tick_cycles = 0;
+		modeldef.pd_value = pd;
+		if (!chipset.LoadCoreState(reader) || (memory && !chipset.LoadMemory(reader)))
+			return false;
+		emulated_seconds_base = seconds;
+		emulated_ticks_base = chipset.ticks_elapsed;
+		stats_last_ticks = chipset.ticks_elapsed;
+		stats_last_instructions = chipset.instructions_executed;
+		return true;
+	}
+
+	bool Emulator::SaveStateFile(const std::string& path) {
+		std::ofstream os(path, std::ofstream::binary);
+		if (os)
+			SaveState(os);
+		if (!os) {
+			logger::Info("[SaveState][Error] Cannot write %s\n", path.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool Emulator::LoadStateFile(const std::string& path) {
+		std::ifstream is(path, std::ifstream::binary);
+		if (!is) {
+			logger::Info("[SaveState][Error] Cannot open %s\n", path.c_str());
+			return false;
+		}
+		return LoadState(is);
 	}
 
 	FairRecursiveMutex::FairRecursiveMutex() : holding{}, recursive_count{} {
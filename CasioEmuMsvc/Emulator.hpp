@@ -1,14 +1,23 @@
 ﻿#pragma once
 #include "Config.hpp"
 #include "ModelInfo.h"
+#include "Containers/SpscQueue.h"
+#include "Gui/Hooks.h"
 #include <string>
 #include <map>
+#include <chrono>
 #include <SDL.h>
 #include <SDL_image.h>
 
+#include <atomic>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
+#include <functional>
+#include <future>
+#include <istream>
+#include <memory>
+#include <ostream>
 #include <queue>
 
 namespace casioemu
@@ -16,6 +25,9 @@ namespace casioemu
 	class Chipset;
 	class CPU;
 	class MMU;
+	class BootCache;
+	class RewindBuffer;
+	class StateReader;
 
 	/**
 	 * A mutex that ensures that a thread cannot get the mutex right after it's released if there are another waiting thread.
@@ -42,7 +54,11 @@ namespace casioemu
 		SDL_Texture *interface_texture;
 		unsigned int cycles_per_second;
 		unsigned int timer_interval;
-		bool running, paused;
+		/**
+		 * Written by the tick thread (pausing) and by whichever thread calls Shutdown, read by
+		 * the UI and batch threads.
+		 */
+		std::atomic<bool> running, paused;
 		unsigned int last_frame_tick_count;
 		std::string model_path;
 		bool pause_on_mem_error;
@@ -52,6 +68,14 @@ namespace casioemu
 		SpriteInfo interface_background;
 		SDL_Rect emu_rect{};
 
+		/**
+		 * Render target Frame draws the calculator into before scaling it to the window. Kept across
+		 * frames; recreated only when the interface size changes or the renderer drops its targets.
+		 */
+		SDL_Texture* frame_texture{};
+		int frame_texture_width{}, frame_texture_height{};
+		void DestroyFrameTexture();
+
 		/**
 		 * A bunch of internally used methods for encapsulation purposes.
 		 */
@@ -60,13 +84,86 @@ namespace casioemu
 		void SetupLuaAPI();
 		void SetupInternals();
 		void RunStartupScript();
+		void UpdatePerformanceStats();
+
+		/**
+		 * Bookkeeping for UpdatePerformanceStats, only touched by the tick thread.
+		 */
+		std::chrono::steady_clock::time_point stats_last_time;
+		Uint64 stats_last_ticks, stats_last_instructions;
+
+		/**
+		 * Emulated time up to the last clock speed change, see GetEmulatedSeconds.
+		 */
+		double emulated_seconds_base;
+		Uint64 emulated_ticks_base;
+
+		/**
+		 * Commands posted by the UI thread, run by the tick thread between instruction slices.
+		 * `posted` is kept to measure how long a command waited.
+		 */
+		struct Command
+		{
+			std::function<void()> run;
+			std::chrono::steady_clock::time_point posted;
+			bool changes_state = true;
+		};
+		SpscQueue<Command, 1024> commands;
+		double command_latency_max;
+		/**
+		 * Returns whether any of the commands run may have changed the machine.
+		 */
+		bool RunCommands();
+		/**
+		 * The EMUCLK tick of the non-real-hardware models, noted for RewindBuffer replays. In turbo
+		 * mode it comes every `emulator_tick_cycles` ticks, counted from the last state load.
+		 */
+		void EmulatorTick();
+		Uint64 emulator_tick_cycles = 0;
+
+		/**
+		 * The run started by RunFor, ticks left and the promise kept once they're done. Tick thread only.
+		 */
+		Uint64 run_ticks_left = 0;
+		std::shared_ptr<std::promise<void>> run_done;
+		void FinishRun();
+		/**
+		 * Lets a paused tick thread sleep until a command is posted instead of polling.
+		 */
+		std::mutex command_mutex;
+		std::condition_variable command_cv;
+		void WaitForCommands(std::chrono::milliseconds timeout);
+
+		unsigned int random_seed;
 
 	public:
 		ModelInfo modeldef{};
 		SDL_Window *window;
+		/**
+		 * Set by the `headless` argument. There's no window, renderer or interface texture then, and
+		 * Frame must not be called; the screen is read through IFramebuffer and input comes in
+		 * through IKeyboard (see HeadlessRunner).
+		 */
+		bool headless;
 		Emulator(std::map<std::string, std::string> &argv_map, bool paused = false);
 		~Emulator();
 
+		/**
+		 * Debugger and script hooks of this instance, see Gui/Hooks.h.
+		 */
+		EmulatorHooks hooks;
+
+		/**
+		 * Set by the `boot_cache` argument, see BootCache. `booted_from_cache` tells whether the
+		 * constructor restored a cached boot state, the firmware is waiting for a key then.
+		 */
+		std::unique_ptr<BootCache> boot_cache;
+		bool booted_from_cache = false;
+		/**
+		 * Checkpoints of the last stretch of emulation, see RewindBuffer. Null with `rewind=0`.
+		 */
+		std::unique_ptr<RewindBuffer> rewind;
+
 		FairRecursiveMutex access_mx;
 		HardwareId hardware_id;
 		std::map<std::string, std::string> &argv_map;
@@ -101,10 +198,41 @@ namespace casioemu
 
 		float BatteryVoltage, SolarPanelVoltage;
 
+		/**
+		 * When turbo is set the tick thread no longer sleeps between timer intervals and
+		 * runs the chipset as fast as the host allows. Peripherals are still clocked from
+		 * emulated cycles (including the EMUCLK tick), so emulated time stays consistent.
+		 */
+		std::atomic<bool> turbo;
+
+		/**
+		 * Achieved instruction rate and speed relative to `cycles_per_second`.
+		 * Refreshed by the tick thread about once per host second.
+		 */
+		std::atomic<double> mips, speed_multiple;
+
+		/**
+		 * Longest time, in milliseconds, a posted command waited for the tick thread during the
+		 * last stats period.
+		 */
+		std::atomic<double> command_latency;
+
 		bool Running();
 		void HandleMemoryError();
 		void Shutdown();
 		void Tick();
+		/**
+		 * Runs exactly `ticks` chipset ticks from the next slice boundary, then pauses; the future
+		 * becomes ready at that point. A new run ends the one in progress. Commands posted meanwhile
+		 * still run between slices, but nothing else starts or stops the machine, so the same
+		 * sequence of commands and runs gives the same machine on any host.
+		 */
+		std::future<void> RunFor(Uint64 ticks);
+		/**
+		 * Seeds for the power-on contents of RAM and VRAM, one per buffer. They start from the `seed`
+		 * argument, 0 when headless so runs repeat, otherwise the host clock.
+		 */
+		unsigned int NextRandomSeed();
 		/**
 		 * Called when SDL_WINDOWEVENT_EXPOSED event is received. Does not re-frame.
 		 */
@@ -114,9 +242,68 @@ namespace casioemu
 		void ExecuteCommand(std::string command);
 		unsigned int GetCyclesPerSecond();
 		void SetClockSpeed(float speed);
+		void SetCyclesPerSecond(Uint64 cycles_per_second);
+		/**
+		 * Emulated time since the emulator was created, derived from the chipset tick count.
+		 */
+		double GetEmulatedSeconds();
+		/**
+		 * Save states of the whole machine: emulated time, clock speed and Chipset::SaveState in the
+		 * container described in SaveState.hpp. Call on the tick thread, e.g. through Call. LoadState
+		 * returns false and logs why if the state doesn't fit this instance or is damaged; the
+		 * machine is then left as it was. The file versions also log their I/O errors. Without
+		 * `memory` RAM and the ROM images are left out and nothing is rolled back, that's how
+		 * RewindBuffer keeps its own checkpoints.
+		 */
+		void SaveState(std::ostream &os, bool memory = true);
+		bool LoadState(std::istream &is, bool memory = true);
+		bool LoadSections(StateReader &reader, double seconds, Uint64 cps, uint8_t pd, bool memory);
+		bool SaveStateFile(const std::string &path);
+		bool LoadStateFile(const std::string &path);
+		/**
+		 * FNV-1a of the ROM, flash and config.bin as loaded, identifies the model in save states.
+		 * Worked out on first use, hashing touches every page of the mapped images. States without
+		 * `memory` never leave the process and carry 0 instead. Tick thread only.
+		 */
+		uint64_t GetModelHash();
+		uint64_t model_hash = 0;
+		bool model_hash_ready = false;
 		bool GetPaused();
 		void SetPaused(bool paused);
+		bool GetTurbo();
+		void SetTurbo(bool turbo);
 		void UIEvent(SDL_Event &event);
+
+		/**
+		 * Runs `command` on the tick thread at the next instruction slice boundary. Anything the UI
+		 * changes in the chipset (key presses, memory and register edits, pausing, clock changes)
+		 * goes through here so the tick thread never races with it or takes a lock. Only the UI
+		 * thread may post; commands posted from the tick thread itself run right away. Unless
+		 * `changes_state` is false, the RewindBuffer takes a checkpoint after the command.
+		 */
+		void Post(std::function<void()> command, bool changes_state = true);
+		/**
+		 * Like Post, but returns a future that becomes ready with the result once `command` ran.
+		 * A command dropped because the emulator shut down leaves the future with a broken promise.
+		 */
+		template <typename F>
+		auto Call(F command) -> std::future<decltype(command())> {
+			auto task = std::make_shared<std::packaged_task<decltype(command())()>>(std::move(command));
+			auto result = task->get_future();
+			Post([task] { (*task)(); });
+			return result;
+		}
+		/**
+		 * Like Call, for a `command` that only reads the machine.
+		 */
+		template <typename F>
+		auto Query(F command) -> std::future<decltype(command())> {
+			auto task = std::make_shared<std::packaged_task<decltype(command())()>>(std::move(command));
+			auto result = task->get_future();
+			Post([task] { (*task)(); }, false);
+			return result;
+		}
+		bool HasPendingCommands();
 		SDL_Renderer *GetRenderer();
 		SDL_Texture *GetInterfaceTexture();
 		std::string GetModelFilePath(std::string relative_path);
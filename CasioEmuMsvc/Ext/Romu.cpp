@@ -28,9 +28,8 @@ inline void calc2(word& sum, byte* bt, int len) {
 	}
 }
 
-RomInfo rom_info(std::vector<byte>& rom, const std::vector<byte>& flash, bool checksum) {
-	auto dat = rom.data();
-	auto dat2 = (byte*)flash.data(); // this is hack xD
+RomInfo rom_info(byte* dat, size_t rom_size, const byte* flash, size_t flash_size, bool checksum) {
+	auto dat2 = (byte*)flash; // this is hack xD
 	RomInfo ri{};
 	auto spinit = *(word*)dat;
 	enum {
@@ -41,10 +40,10 @@ RomInfo rom_info(std::vector<byte>& rom, const std::vector<byte>& flash, bool ch
 		CWII,
 	} sum_type{};
 	if (spinit == 0xf000) { // cwx or cwii
-		if (rom.size() < 0x40000) {
+		if (rom_size < 0x40000) {
 			return ri;
 		}
-		if (rom.size() == 0x40000) { // must be cwx
+		if (rom_size == 0x40000) { // must be cwx
 		cwx_p:
 			memcpy(ri.ver, &dat[0x3ffee], 8);
 			memcpy(ri.cid, &dat[0x3fff8], 8);
@@ -56,11 +55,11 @@ RomInfo rom_info(std::vector<byte>& rom, const std::vector<byte>& flash, bool ch
 			if (ri.ver[0] == 'C' && ri.ver[1] == 'Y') {
 				goto cwx_p;
 			}
-			if (rom.size() < 0x60000) {
+			if (rom_size < 0x60000) {
 				return ri;
 			}
 			if (dat[0x5ffee] != 'E') { // this means... it is stored at 0x71xxx
-				if (rom.size() < 0x80000) {
+				if (rom_size < 0x80000) {
 					return ri;
 				}
 				memcpy(&dat[0x5e000], &dat[0x70000], 0x2000);
@@ -86,7 +85,7 @@ RomInfo rom_info(std::vector<byte>& rom, const std::vector<byte>& flash, bool ch
 	else {
 		auto str = (byte*)FindSignature(dat, 0x8000, "49 4E 52 4f 4d 2D");
 		if (str) {
-			if (flash.size() < 0x80000) {
+			if (flash_size < 0x80000) {
 				return ri;
 			}
 			ri.type = RomInfo::Fx5800p;
@@ -106,7 +105,7 @@ RomInfo rom_info(std::vector<byte>& rom, const std::vector<byte>& flash, bool ch
 			return ri;
 		}
 
-		if (rom.size() < 0x20000) {
+		if (rom_size < 0x20000) {
 			return ri;
 		}
 		memcpy(ri.ver, &dat[0x1fff4], 8);
@@ -28,4 +28,9 @@ inline char get_pd(byte pd) {
 	return int(lg) + '0';
 }
 
-RomInfo rom_info(std::vector<byte>& rom, const std::vector<byte>& flash, bool checksum = true);
\ No newline at end of file
+// Some ClassWiz II dumps keep the version block at 0x70000, rom_info moves it to 0x5E000 in place.
+// checksum = false only identifies the ROM, without reading the whole image.
+RomInfo rom_info(byte* rom, size_t rom_size, const byte* flash, size_t flash_size, bool checksum = true);
+inline RomInfo rom_info(std::vector<byte>& rom, const std::vector<byte>& flash, bool checksum = true) {
+	return rom_info(rom.data(), rom.size(), flash.data(), flash.size(), checksum);
+}
\ No newline at end of file
@@ -37,15 +37,10 @@ inline std::string tobin(int n, int len) {
 	}
 	return retval;
 }
-std::map<int,bool> p_labels;
-inline void LABEL_FUNCTION(auto x) {
-	p_labels[x] = true;
-}
-inline void LABEL_LABEL(auto x) {
-	p_labels[x];
-}
+#define LABEL_FUNCTION(x) (labels[(x)] = true)
+#define LABEL_LABEL(x) (labels[(x)])
 
-void decode(std::ostream& out, uint8_t*& buf, uint32_t pc) {
+void decode(std::ostream& out, uint8_t*& buf, uint32_t pc, std::map<int,bool>& labels) {
 	static const char* cond[16] = {"GE ", "LT ", "GT ", "LE ", "GES", "LTS", "GTS", "LES",
 		"NE ", "EQ ", "NV ", "OV ", "PS ", "NS ", "   ", ""};
 
@@ -3,6 +3,5 @@
 #include <iostream>
 #include <string>
 #include <map>
-extern std::map<int,bool> p_labels;
-
-void decode(std::ostream& out,uint8_t*& buf, uint32_t pc);
\ No newline at end of file
+// `labels` collects branch targets, true for call targets
+void decode(std::ostream& out,uint8_t*& buf, uint32_t pc, std::map<int,bool>& labels);
\ No newline at end of file
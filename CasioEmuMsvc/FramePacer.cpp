@@ -0,0 +1,97 @@
+﻿#include "FramePacer.hpp"
+
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace casioemu {
+	void FramePacer::Setup(const std::string& value, SDL_Window* window) {
+		if (value.empty() || value == "ondemand") {
+			Setup(PACE_ON_DEMAND, 0);
+		}
+		else if (value == "display") {
+			Setup(PACE_DISPLAY, 0);
+		}
+		else {
+			double hz = std::atof(value.c_str());
+			if (hz <= 0) {
+				logger::Info("[FramePacer][Warn] invalid frame_pacing '%s', pacing to the display\n", value.c_str());
+				Setup(PACE_DISPLAY, 0);
+			}
+			else {
+				Setup(PACE_FIXED, hz);
+			}
+		}
+		// On demand frames are capped at the display refresh rate too.
+		if (mode != PACE_FIXED) {
+			SDL_DisplayMode display_mode{};
+			int display = window ? SDL_GetWindowDisplayIndex(window) : 0;
+			if (display >= 0 && SDL_GetCurrentDisplayMode(display, &display_mode) == 0 && display_mode.refresh_rate > 0)
+				Setup(mode, display_mode.refresh_rate);
+			else
+				Setup(mode, 60);
+		}
+		logger::Info("[FramePacer][Info] %s, %.0f fps\n", mode == PACE_ON_DEMAND ? "on demand" : mode == PACE_FIXED ? "fixed rate" : "display rate", rate);
+	}
+
+	void FramePacer::Setup(Mode _mode, double _rate) {
+		mode = _mode;
+		if (_rate > 0)
+			rate = _rate;
+		period = (Uint64)(SDL_GetPerformanceFrequency() / rate);
+		next_frame = SDL_GetPerformanceCounter();
+		if (!wake_event)
+			wake_event = SDL_RegisterEvents(1);
+	}
+
+	FramePacer::Mode FramePacer::GetMode() {
+		return mode;
+	}
+
+	double FramePacer::GetRate() {
+		return rate;
+	}
+
+	int FramePacer::GetTimeout() {
+		if (mode == PACE_ON_DEMAND && !frame_requested)
+			return -1;
+		Uint64 now = SDL_GetPerformanceCounter();
+		if (now >= next_frame)
+			return 0;
+		// Round up, waking early would only spin until the deadline.
+		return (int)std::ceil((next_frame - now) * 1000.0 / SDL_GetPerformanceFrequency());
+	}
+
+	bool FramePacer::FrameDue() {
+		if (mode == PACE_ON_DEMAND && !frame_requested)
+			return false;
+		if (SDL_GetPerformanceCounter() < next_frame)
+			return false;
+		// Taken before the frame is drawn, so a request made while drawing asks for another one.
+		frame_requested = false;
+		return true;
+	}
+
+	void FramePacer::FrameDone() {
+		Uint64 now = SDL_GetPerformanceCounter();
+		next_frame += period;
+		// Don't try to catch up on frames missed while idle or stalled.
+		if (next_frame < now)
+			next_frame = now + (mode == PACE_ON_DEMAND ? 0 : period);
+	}
+
+	void FramePacer::RequestFrame() {
+		if (mode != PACE_ON_DEMAND)
+			return;
+		if (frame_requested.exchange(true))
+			return;
+		SDL_Event event{};
+		event.type = wake_event;
+		SDL_PushEvent(&event);
+	}
+
+	bool FramePacer::IsWakeEvent(const SDL_Event& event) {
+		return event.type == wake_event;
+	}
+} // namespace casioemu
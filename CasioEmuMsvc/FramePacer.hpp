@@ -0,0 +1,66 @@
+﻿#pragma once
+#include "Config.hpp"
+
+#include <SDL.h>
+#include <atomic>
+#include <string>
+
+namespace casioemu {
+	/**
+	 * Decides when the main loop produces a frame and how long it may sleep in
+	 * SDL_WaitEventTimeout meanwhile.
+	 *
+	 * PACE_DISPLAY and PACE_FIXED produce frames at a steady rate (the refresh rate of the
+	 * window's display, or `rate`). PACE_ON_DEMAND only produces a frame after `RequestFrame`,
+	 * at most `rate` times per second, and otherwise sleeps until the next event.
+	 */
+	class FramePacer {
+	public:
+		enum Mode {
+			PACE_DISPLAY,
+			PACE_FIXED,
+			PACE_ON_DEMAND
+		};
+
+	private:
+		Mode mode = PACE_ON_DEMAND;
+		double rate = 60;
+		Uint64 period{}, next_frame{};
+		std::atomic<bool> frame_requested{true};
+
+		/**
+		 * Pushed by `RequestFrame` to wake a main loop that is waiting for events.
+		 */
+		Uint32 wake_event{};
+
+	public:
+		/**
+		 * Parses the `frame_pacing` argument: "ondemand" (default), "display", or a frame rate in Hz.
+		 * `window` is used to look up the display refresh rate.
+		 */
+		void Setup(const std::string& value, SDL_Window* window);
+		void Setup(Mode mode, double rate);
+		Mode GetMode();
+		double GetRate();
+
+		/**
+		 * Milliseconds the main loop may wait for events before the next frame is due, or -1 to
+		 * wait until an event arrives.
+		 */
+		int GetTimeout();
+		/**
+		 * True if the main loop should draw a frame now. Takes the pending request with it.
+		 */
+		bool FrameDue();
+		/**
+		 * Called once the frame is drawn, schedules the next one.
+		 */
+		void FrameDone();
+
+		/**
+		 * Asks for a frame in PACE_ON_DEMAND mode. May be called from any thread.
+		 */
+		void RequestFrame();
+		bool IsWakeEvent(const SDL_Event& event);
+	};
+} // namespace casioemu
@@ -0,0 +1,104 @@
+﻿#include "FrameRecorder.hpp"
+
+#include "Logger.hpp"
+
+#include <SDL_image.h>
+#include <csignal>
+#include <cstdlib>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+// Frames are binary, keep the CRT from translating newlines.
+#define POPEN_WRITE "wb"
+#else
+// POSIX popen takes only "r" or "w", pipes have no text mode there.
+#define POPEN_WRITE "w"
+#endif
+
+namespace casioemu {
+	FrameRecorder::FrameRecorder(const std::string& _target, Format _format) : format(_format), target(_target) {
+		if (format == FORMAT_PIPE) {
+			pipe = popen(target.c_str(), POPEN_WRITE);
+			if (!pipe)
+				PANIC("Cannot start frame encoder '%s'\n", target.c_str());
+#ifndef _WIN32
+			// An encoder that exits early would kill the emulator on the next write, fail the write instead.
+			signal(SIGPIPE, SIG_IGN);
+#endif
+		}
+	}
+
+	FrameRecorder::~FrameRecorder() {
+		if (pipe)
+			pclose(pipe);
+		logger::Info("[FrameRecorder][Info] %u frames written\n", frame_index);
+	}
+
+	FrameRecorder* FrameRecorder::Create(std::map<std::string, std::string>& argv_map, int width, int height, int& fps) {
+		auto record = argv_map.find("record");
+		if (record == argv_map.end() || record->second.empty())
+			return nullptr;
+		Format format = FORMAT_PNG;
+		auto record_format = argv_map.find("record_format");
+		if (record_format != argv_map.end()) {
+			if (record_format->second == "raw")
+				format = FORMAT_RAW;
+			else if (record_format->second == "pipe")
+				format = FORMAT_PIPE;
+			else if (record_format->second != "png")
+				PANIC("Unknown record_format '%s'\n", record_format->second.c_str());
+		}
+		fps = 30;
+		auto record_fps = argv_map.find("record_fps");
+		if (record_fps != argv_map.end() && std::atoi(record_fps->second.c_str()) > 0)
+			fps = std::atoi(record_fps->second.c_str());
+		logger::Info("[FrameRecorder][Info] recording %dx%d bgra frames at %d fps of emulated time to '%s'\n", width, height, fps, record->second.c_str());
+		return new FrameRecorder(record->second, format);
+	}
+
+	std::string FrameRecorder::FrameFile(const char* extension) {
+		char number[16];
+		snprintf(number, sizeof(number), "%06u", frame_index);
+		return target + number + extension;
+	}
+
+	void FrameRecorder::WriteFrame(SDL_Surface* frame) {
+		if (format == FORMAT_PNG) {
+			auto file = FrameFile(".png");
+			if (IMG_SavePNG(frame, file.c_str()) != 0)
+				logger::Info("[FrameRecorder][Warn] cannot write %s: %s\n", file.c_str(), IMG_GetError());
+		}
+		else {
+			FILE* out = pipe;
+			std::string file;
+			if (format == FORMAT_PIPE && !pipe)
+				return;
+			if (format == FORMAT_RAW) {
+				file = FrameFile(".raw");
+				out = fopen(file.c_str(), "wb");
+				if (!out) {
+					logger::Info("[FrameRecorder][Warn] cannot write %s\n", file.c_str());
+					++frame_index;
+					return;
+				}
+			}
+			bool written = true;
+			SDL_LockSurface(frame);
+			for (int y = 0; written && y != frame->h; ++y)
+				written = fwrite((Uint8*)frame->pixels + y * frame->pitch, sizeof(Uint32), frame->w, out) == (size_t)frame->w;
+			SDL_UnlockSurface(frame);
+			written = written && !ferror(out);
+			if (format == FORMAT_RAW) {
+				if (fclose(out) != 0 || !written)
+					logger::Info("[FrameRecorder][Warn] cannot write %s\n", file.c_str());
+			}
+			else if (!written) {
+				logger::Info("[FrameRecorder][Error] frame encoder '%s' stopped taking frames, recording ends\n", target.c_str());
+				pclose(pipe);
+				pipe = nullptr;
+			}
+		}
+		++frame_index;
+	}
+} // namespace casioemu
@@ -0,0 +1,47 @@
+﻿#pragma once
+#include "Config.hpp"
+
+#include <SDL.h>
+#include <cstdio>
+#include <map>
+#include <string>
+
+namespace casioemu {
+	/**
+	 * Writes composited frames out as a raw or PNG image sequence, or as raw video to the stdin
+	 * of an external encoder. Frames are ARGB8888 surfaces, which is "bgra" in memory order.
+	 * Works entirely on the CPU, no window or renderer is needed.
+	 */
+	class FrameRecorder {
+	public:
+		enum Format {
+			FORMAT_RAW,
+			FORMAT_PNG,
+			FORMAT_PIPE
+		};
+
+	private:
+		Format format;
+		std::string target;
+		FILE* pipe{};
+		unsigned int frame_index{};
+
+		std::string FrameFile(const char* extension);
+
+	public:
+		/**
+		 * `target` is the file name prefix for image sequences (a frame number and extension are
+		 * appended) or the encoder command line for FORMAT_PIPE.
+		 */
+		FrameRecorder(const std::string& target, Format format);
+		~FrameRecorder();
+
+		/**
+		 * Builds a recorder from the `record`, `record_format` (raw, png or pipe) and `record_fps`
+		 * arguments, or returns nullptr if `record` isn't given. `fps` receives the frame rate.
+		 */
+		static FrameRecorder* Create(std::map<std::string, std::string>& argv_map, int width, int height, int& fps);
+
+		void WriteFrame(SDL_Surface* frame);
+	};
+} // namespace casioemu
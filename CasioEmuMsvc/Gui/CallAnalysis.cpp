@@ -3,6 +3,7 @@
 #include "Hooks.h"
 #include "Ui.hpp"
 #include "imgui/imgui.h"
+#include <mutex>
 
 struct CallAnalysis : public UIWindow {
 	bool is_call_recoding = false;
@@ -21,8 +22,12 @@ struct CallAnalysis : public UIWindow {
 	};
 	std::map<uint32_t, std::vector<FunctionCall>> funcs;
 	std::vector<FunctionCall> viewing_calls;
+	// Calls recorded by the emulation thread since the last frame. The UI only takes the vector
+	// over under the lock and merges it into `funcs` afterwards.
+	std::mutex pending_mutex;
+	std::vector<FunctionCall> pending_calls;
 	CallAnalysis() : UIWindow("Funcs") {
-		SetupHook(on_call_function, [this](casioemu::CPU& sender, const FunctionEventArgs& ea) {
+		SetupHook(m_emu->hooks.on_call_function, [this](casioemu::CPU& sender, const FunctionEventArgs& ea) {
 			OnCallFunction(sender, ea.pc, ea.lr);
 		});
 	}
@@ -41,10 +46,18 @@ struct CallAnalysis : public UIWindow {
 			fc.pc = pc;
 			fc.lr = lr;
 			fc.stack = sender.GetBacktrace(); // 已经上锁了，草（
-			funcs[pc].push_back(fc);
+			std::lock_guard<std::mutex> lock(pending_mutex);
+			pending_calls.push_back(std::move(fc));
 		}
 	}
 	void RenderCore() override {
+		std::vector<FunctionCall> calls;
+		{
+			std::lock_guard<std::mutex> lock(pending_mutex);
+			calls.swap(pending_calls);
+		}
+		for (auto& fc : calls)
+			funcs[fc.pc].push_back(std::move(fc));
 		if (is_call_recoding) {
 			if (ImGui::Button(
 #if LANGUAGE == 2
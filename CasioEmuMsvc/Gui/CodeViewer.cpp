@@ -5,6 +5,7 @@
 #include "Emulator.hpp"
 #include "Hooks.h"
 #include "Logger.hpp"
+#include "RewindBuffer.hpp"
 #include "U8Disas.h"
 #include "imgui/imgui.h"
 #include <algorithm>
@@ -39,7 +40,7 @@ CodeElem CodeViewer::LookUp(uint32_t offset, int* idx) {
 CodeViewer* cv_a;
 
 void CodeViewer::SetupHooks() {
-	SetupHook(on_instruction,
+	SetupHook(m_emu->hooks.on_instruction,
 		[&](casioemu::CPU& cup, InstructionEventArgs& iea) {
 			pc_cache = iea.pc_after;
 			if (stepping) {
@@ -115,10 +116,11 @@ void CodeViewer::PrepareDisasm() {
 		auto end = rom + m_emu->chipset.rom_data.size();
 		printf("[UI][Info] Pass1: decoding opcodes...\n");
 		std::stringstream ss{};
+		std::map<int, bool> branch_labels;
 		while (rom < end) {
 			auto pc = rom - beg;
 			auto before = rom;
-			decode(ss, rom, rom - beg);
+			decode(ss, rom, rom - beg, branch_labels);
 			auto size = rom - before;
 			CodeElem ce{};
 			if (size == 2) {
@@ -146,7 +148,7 @@ void CodeViewer::PrepareDisasm() {
 			quick_find.emplace(ce.offset);
 		}
 		std::map<int, std::string> labels;
-		for (auto& lb : p_labels) {
+		for (auto& lb : branch_labels) {
 			CodeElem ce{};
 			auto iter = quick_find.find(lb.first);
 			if (iter == quick_find.end()) // 如果找不到指令那就是错误解码数据了
@@ -282,8 +284,7 @@ void CodeViewer::DrawContent() {
 
 void CodeViewer::DrawMonitor() {
 	if (m_emu != nullptr) {
-		casioemu::Chipset& chipset = m_emu->chipset;
-		std::string s = chipset.cpu.GetBacktrace();
+		std::string s = m_emu->chipset.cpu.stack_snapshot.Load().GetBacktrace();
 		ImGui::InputTextMultiline("##as", (char*)s.c_str(), s.size(), ImVec2(ImGui::GetWindowWidth(), -1), ImGuiInputTextFlags_ReadOnly);
 	}
 }
@@ -358,40 +359,67 @@ void CodeViewer::RenderCore() {
 	ImGui::SameLine();
 	if (m_emu->GetPaused()) {
 		if (ImGui::Button("Step")) {
-			stepping = true;
-			m_emu->SetPaused(false);
+			m_emu->Post([this] {
+				stepping = true;
+				m_emu->SetPaused(false);
+			});
 		}
 		ImGui::SameLine();
 		if (ImGui::Button("Trace")) {
-			tracing = true;
-			m_emu->SetPaused(false);
+			m_emu->Post([this] {
+				tracing = true;
+				m_emu->SetPaused(false);
+			});
 		}
 		ImGui::SameLine();
 		if (ImGui::Button("Jump out")) {
-			auto stk = m_emu->chipset.cpu.stack.get();
-			if (!stk->empty()) {
-				if (!stk->back().is_jump) {
-					if (stk->back().lr_pushed) {
-						trace_bp = stk->back().lr;
-					}
-					else {
-						trace_bp = m_emu->chipset.cpu.reg_lcsr << 16 | m_emu->chipset.cpu.reg_lr;
-					}
-					m_emu->SetPaused(false);
+			auto stk = m_emu->chipset.cpu.stack_snapshot.Load();
+			if (stk.count) {
+				auto& back = stk.frames[stk.count - 1];
+				if (!back.is_jump) {
+					auto bp = back.lr_pushed ? back.lr : stk.lr;
+					m_emu->Post([this, bp] {
+						trace_bp = bp;
+						m_emu->SetPaused(false);
+					});
 				}
 			}
 		}
 		ImGui::SameLine();
 		if (ImGui::Button("Continue")) {
-			m_emu->SetPaused(false);
+			m_emu->Post([] { m_emu->SetPaused(false); });
 		}
 		ImGui::SameLine();
+		if (m_emu->rewind) {
+			// Both replay from a rewind checkpoint, see RewindBuffer.
+			if (ImGui::Button("Step back")) {
+				m_emu->Post([this] {
+					m_emu->rewind->StepBack();
+					JumpTo(pc_cache = m_emu->chipset.cpu.reg_csr << 16 | m_emu->chipset.cpu.reg_pc);
+				});
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Continue back")) {
+				std::unordered_set<uint32_t> stops;
+				for (auto& [line, state] : break_points)
+					if (state == 1)
+						stops.insert(codes[line].offset);
+				m_emu->Post([this, stops = std::move(stops)] {
+					auto& cpu = m_emu->chipset.cpu;
+					m_emu->rewind->ContinueBack([&] { return stops.count(cpu.reg_csr << 16 | cpu.reg_pc) != 0; });
+					JumpTo(pc_cache = cpu.reg_csr << 16 | cpu.reg_pc);
+				});
+			}
+			ImGui::SameLine();
+		}
 	}
 	else {
 		if (ImGui::Button("Pause")) {
-			trace_bp = false;
-			stepping = false;
-			m_emu->SetPaused(true);
+			m_emu->Post([this] {
+				trace_bp = 0;
+				stepping = false;
+				m_emu->SetPaused(true);
+			});
 			JumpTo(pc_cache);
 		}
 		ImGui::SameLine();
@@ -7,6 +7,8 @@
 #include "hex.hpp"
 #include "MemBreakPoint.hpp"
 float ram_edit_ov[0x100000]{};
+// SP for Highlight_Default, loaded from the CPU snapshot once per draw rather than for every byte.
+static uint16_t highlight_sp;
 struct HexEditor : public UIWindow, public MemoryEditor {
 	void* data{};
 	size_t size{};
@@ -23,6 +25,8 @@ struct HexEditor : public UIWindow, public MemoryEditor {
 		};
 	}
 	void RenderCore() override {
+		if (HighlightFn)
+			highlight_sp = m_emu->chipset.cpu.snapshot.Load().reg_sp;
 		this->DrawContents(data, size, display_base);
 		if (open_popup) {
 			ImGui::OpenPopup("ContextMenu");
@@ -58,6 +62,8 @@ struct SpansHexEditor : public UIWindow, public MemoryEditor {
 		};
 	}
 	void RenderCore() override {
+		if (HighlightFn)
+			highlight_sp = m_emu->chipset.cpu.snapshot.Load().reg_sp;
 		this->DrawContents(data, size, display_base, spans);
 		if (open_popup) {
 			ImGui::OpenPopup("ContextMenu");
@@ -81,13 +87,24 @@ inline auto MMU_Hex(auto he) {
 		return me_mmu->ReadData((size_t)data + off, 0);
 	};
 	he->WriteFn = [](ImU8* data, size_t off, ImU8 d) {
-		return me_mmu->WriteData((size_t)data + off, d, 0);
+		m_emu->Post([addr = (size_t)data + off, d] { me_mmu->WriteData(addr, d, 0); });
+	};
+	return he;
+}
+// ROM and flash images may be shared with other instances, writes make them private first.
+template <casioemu::RomImage casioemu::Chipset::*image>
+inline auto Image_Hex(auto he) {
+	he->ReadFn = [](const ImU8* data, size_t off) -> ImU8 {
+		return (m_emu->chipset.*image)[off];
+	};
+	he->WriteFn = [](ImU8* data, size_t off, ImU8 d) {
+		m_emu->Post([off, d] { (m_emu->chipset.*image).MakeWritable(off, 1)[off] = d; });
 	};
 	return he;
 }
 inline auto Highlight_Default(auto he) {
 	he->HighlightFn = [](const ImU8* data, size_t off) -> bool {
-		if ((size_t)(data + off) == m_emu->chipset.cpu.reg_sp) {
+		if ((size_t)(data + off) == highlight_sp) {
 			return true;
 		}
 		if ((size_t)(data + off) == casioemu::GetInputAreaOffset(m_emu->hardware_id) + *((unsigned char*)n_ram_buffer - casioemu::GetRamBaseAddr(m_emu->hardware_id) + casioemu::GetCursorOffset(m_emu->hardware_id))) {
@@ -99,7 +116,7 @@ inline auto Highlight_Default(auto he) {
 }
 
 std::vector<UIWindow*> GetEditors() {
-	SetupHook(on_memory_write, [](casioemu::MMU& mmu, MemoryEventArgs& mea) {
+	SetupHook(m_emu->hooks.on_memory_write, [](casioemu::MMU& mmu, MemoryEventArgs& mea) {
 		if (mea.offset < 0x80000)
 			ram_edit_ov[mea.offset] = 255;
 	});
@@ -113,10 +130,10 @@ std::vector<UIWindow*> GetEditors() {
 					0x10000 - casioemu::GetRamBaseAddr(m_emu->hardware_id),
 					casioemu::GetRamBaseAddr(m_emu->hardware_id),
 					GetCommonMemLabels(m_emu->hardware_id)})));
-	windows.push_back(new HexEditor{"Rom", m_emu->chipset.rom_data.data(), m_emu->chipset.rom_data.size(), 0});
+	windows.push_back(Image_Hex<&casioemu::Chipset::rom_data>(new HexEditor{"Rom", 0, m_emu->chipset.rom_data.size(), 0}));
 	if (m_emu->hardware_id == casioemu::HW_FX_5800P) {
 		windows.push_back(MMU_Hex(new SpansHexEditor{"PRam", (void*)0x40000, 0x8000, 0x40000, GetCommonMemLabels(m_emu->hardware_id)}));
-		windows.push_back(new HexEditor{"Flash", m_emu->chipset.flash_data.data(), m_emu->chipset.flash_data.size(), 0});
+		windows.push_back(Image_Hex<&casioemu::Chipset::flash_data>(new HexEditor{"Flash", 0, m_emu->chipset.flash_data.size(), 0}));
 	}
 	windows.push_back(MMU_Hex(new HexEditor{"All", 0, 0xfffff, 0}));
 	return windows;
@@ -24,18 +24,24 @@ struct InstructionEventArgs {
 	bool should_break{};
 };
 
-extern std::function<void(casioemu::CPU&, InstructionEventArgs&)> on_instruction;
+// hooks of one emulator instance (Emulator::hooks), raised on its emulation thread
+struct EmulatorHooks {
+	std::function<void(casioemu::CPU&, InstructionEventArgs&)> on_instruction;
 
-extern std::function<void(casioemu::CPU&, const FunctionEventArgs&)> on_call_function;
-extern std::function<void(casioemu::CPU&, const FunctionEventArgs&)> on_function_return;
+	std::function<void(casioemu::CPU&, const FunctionEventArgs&)> on_call_function;
+	std::function<void(casioemu::CPU&, const FunctionEventArgs&)> on_function_return;
 
-extern std::function<void(casioemu::MMU&, MemoryEventArgs&)> on_memory_read;
-extern std::function<void(casioemu::MMU&, MemoryEventArgs&)> on_memory_write;
+	std::function<void(casioemu::MMU&, MemoryEventArgs&)> on_memory_read;
+	std::function<void(casioemu::MMU&, MemoryEventArgs&)> on_memory_write;
 
-extern std::function<void(casioemu::Chipset&, InterruptEventArgs&)> on_brk;
-extern std::function<void(casioemu::Chipset&, InterruptEventArgs&)> on_interrupt;
+	std::function<void(casioemu::Chipset&, InterruptEventArgs&)> on_brk;
+	std::function<void(casioemu::Chipset&, InterruptEventArgs&)> on_interrupt;
 
-extern std::function<void(casioemu::Chipset&)> on_reset;
+	std::function<void(casioemu::Chipset&)> on_reset;
+
+	// raised when the LCD output changed, or is still fading or flashing
+	std::function<void(casioemu::Emulator&)> on_screen_changed;
+};
 
 #define RaiseEvent(func, ...) \
 	if (func)                 \
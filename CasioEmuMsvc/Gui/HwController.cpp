@@ -3,6 +3,9 @@
 #include "Ui.hpp"
 #include "imgui\imgui.h"
 #include "Chipset.hpp"
+#include "RewindBuffer.hpp"
+
+#include <sstream>
 
 int screen_flashing_threshold = 20;
 float screen_fading_blending_coefficient = 0;
@@ -63,9 +66,103 @@ void HwController::RenderCore() {
 #endif
 			,
 			&cps, 1, 28, "2^%d CPS")) {
-		m_emu->cycles.Setup((Uint64)1 << cps, m_emu->cycles.timer_interval);
+		m_emu->Post([cps = cps] { m_emu->SetCyclesPerSecond((Uint64)1 << cps); });
 	}
 	ImGui::Text("%.6f MHz", (double)m_emu->cycles.cycles_per_second / 1024 / 1024);
+	bool turbo = m_emu->GetTurbo();
+	if (ImGui::Checkbox(
+#if LANGUAGE == 2
+			"加速模式"
+#else
+			"Turbo"
+#endif
+			,
+			&turbo))
+		m_emu->SetTurbo(turbo);
+	ImGui::Text("%.2f MIPS, %.2fx", m_emu->mips.load(), m_emu->speed_multiple.load());
+	ImGui::Text(
+#if LANGUAGE == 2
+		"输入延迟 %.2f ms"
+#else
+		"Input latency %.2f ms"
+#endif
+		,
+		m_emu->command_latency.load());
+	ImGui::Separator();
+	// Save states are taken and loaded on the emulation thread, the quick slot lives there too.
+	static char state_path[260] = "state.bin";
+	static std::string quick_state;
+	ImGui::InputText("##state_path", state_path, sizeof(state_path));
+	ImGui::SameLine();
+	if (ImGui::Button(
+#if LANGUAGE == 2
+			"保存状态"
+#else
+			"Save state"
+#endif
+			)) {
+		m_emu->Post([path = std::string(state_path)] { m_emu->SaveStateFile(path); }, false);
+	}
+	ImGui::SameLine();
+	if (ImGui::Button(
+#if LANGUAGE == 2
+			"读取状态"
+#else
+			"Load state"
+#endif
+			)) {
+		m_emu->Post([path = std::string(state_path)] { m_emu->LoadStateFile(path); });
+	}
+	if (ImGui::Button(
+#if LANGUAGE == 2
+			"快速保存"
+#else
+			"Quick save"
+#endif
+			)) {
+		m_emu->Post([] {
+			std::ostringstream os;
+			m_emu->SaveState(os);
+			quick_state = os.str();
+		});
+	}
+	ImGui::SameLine();
+	if (ImGui::Button(
+#if LANGUAGE == 2
+			"快速读取"
+#else
+			"Quick load"
+#endif
+			)) {
+		m_emu->Post([] {
+			if (quick_state.empty())
+				return;
+			std::istringstream is(quick_state);
+			m_emu->LoadState(is);
+		});
+	}
+	if (m_emu->rewind) {
+		static float rewind_seconds = 1;
+		ImGui::SliderFloat("##rewind_seconds", &rewind_seconds, 0.1f, 30.0f, "%.1f s");
+		ImGui::SameLine();
+		if (ImGui::Button(
+#if LANGUAGE == 2
+				"倒带"
+#else
+				"Rewind"
+#endif
+				)) {
+			m_emu->Post([seconds = rewind_seconds] { m_emu->rewind->Rewind(seconds); });
+		}
+		ImGui::Text(
+#if LANGUAGE == 2
+			"可倒带 %.1f s"
+#else
+			"%.1f s available"
+#endif
+			,
+			m_emu->rewind->GetSpan());
+	}
 	static int pd = m_emu->modeldef.pd_value;
 	static bool pdx[8];
 
@@ -96,13 +193,13 @@ void HwController::RenderCore() {
 				pd |= (1 << i);
 			}
 		}
-		m_emu->modeldef.pd_value = pd;
+		m_emu->Post([pd = pd] { m_emu->modeldef.pd_value = pd; });
 	}
 
 	static int irq = 0;
 	ImGui::InputInt("##0d000721",&irq);
 	if (ImGui::Button("中断")) {
-		m_emu->chipset.RaiseMaskable(irq);
+		m_emu->Post([irq = irq] { m_emu->chipset.RaiseMaskable(irq); });
 	}
 	//	static char buf4[40];
 	//	ImGui::InputText("##cps_in", buf4, 40);
@@ -9,6 +9,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <string>
+#include <vector>
 
 #include "Config.hpp"
 #include "Ui.hpp"
@@ -74,7 +75,11 @@ void Injector::RenderCore() {
 			"Load to input area"
 #endif
 			)) {
-		memcpy(base_addr + inputbase, data_buf, range);
+		// Through the MMU, so the rewind buffer sees the pages change.
+		m_emu->Post([inputbase, input = std::vector<char>(data_buf, data_buf + range)] {
+			for (size_t j = 0; j != input.size(); ++j)
+				me_mmu->WriteData(inputbase + j, (uint8_t)input[j]);
+		});
 		info_msg = "字符串已加载";
 		ImGui::OpenPopup("info");
 	}
@@ -99,16 +104,21 @@ void Injector::RenderCore() {
 #endif
 			)) {
 		int off = atoi(buf);
+		std::vector<char> input(off + 2);
 		if (off > 100) {
-			memset(base_addr + inputbase, 0x31, 100);
-			memset(base_addr + inputbase + 100, 0xa6, 1);
-			memset(base_addr + inputbase + 101, 0x31, off - 100);
+			memset(input.data(), 0x31, 100);
+			memset(input.data() + 100, 0xa6, 1);
+			memset(input.data() + 101, 0x31, off - 100);
 		}
 		else {
-			memset(base_addr + inputbase, 0x31, off);
+			memset(input.data(), 0x31, off);
 		}
-		*(base_addr + inputbase + off) = 0xfd;
-		*(base_addr + inputbase + off + 1) = 0x20;
+		input[off] = (char)0xfd;
+		input[off + 1] = 0x20;
+		m_emu->Post([inputbase, input = std::move(input)] {
+			for (size_t j = 0; j != input.size(); ++j)
+				me_mmu->WriteData(inputbase + j, (uint8_t)input[j]);
+		});
 #if LANGUAGE == 2
 		info_msg = "\"an\" 已输入";
 #else
@@ -178,8 +188,9 @@ void Injector::RenderCore() {
 				return true;
 			return false;
 		};
-		size_t i = 0, j = 0;
+		size_t i = 0;
 		char hex_buf[3];
+		std::vector<uint8_t> bytes;
 		while (strbuf[i] != '\0' && strbuf[i + 1] != '\0') {
 			if (strbuf[i] == ';' || strbuf[i + 1] == ';') {
 				// begin comment; skip the rest of the line
@@ -199,13 +210,16 @@ void Injector::RenderCore() {
 				}
 				hex_buf[0] = strbuf[i], hex_buf[1] = strbuf[i + 1], hex_buf[2] = '\0';
 				uint8_t byte = strtoul(hex_buf, nullptr, 16);
-				me_mmu->WriteData(plc + j, byte);
+				bytes.push_back(byte);
 				//*(data_buf + j) = (char)byte;
 				i += 2;
-				++j;
 			}
 		}
 	exit:
+		m_emu->Post([plc, bytes = std::move(bytes)] {
+			for (size_t j = 0; j != bytes.size(); ++j)
+				me_mmu->WriteData(plc + j, bytes[j]);
+		});
 		ImGui::OpenPopup("info");
 	}
 
@@ -147,7 +147,7 @@ void MemBreakPoint::DrawFindContent() {
 }
 
 void MemBreakPoint::SetupHooks() {
-	SetupHook(on_memory_read, [&](casioemu::MMU& sender, MemoryEventArgs& mea) {
+	SetupHook(m_emu->hooks.on_memory_read, [&](casioemu::MMU& sender, MemoryEventArgs& mea) {
 		if (break_on_cv) {
 			if (target_addr == -1) {
 				return;
@@ -161,7 +161,7 @@ void MemBreakPoint::SetupHooks() {
 			TryTrigBp(mea.offset, 0);
 		}
 	});
-	SetupHook(on_memory_write, [&](casioemu::MMU& sender, MemoryEventArgs& mea) {
+	SetupHook(m_emu->hooks.on_memory_write, [&](casioemu::MMU& sender, MemoryEventArgs& mea) {
 		if (break_on_cv) {
 			if (target_addr == -1) {
 				return;
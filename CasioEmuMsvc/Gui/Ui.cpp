@@ -11,6 +11,7 @@
 #include "LabelFile.h"
 #include "LabelViewer.h"
 #include "MemBreakPoint.hpp"
+#include "Peripheral/BatteryBackedRAM.hpp"
 #include "VariableWindow.h"
 #include "WatchWindow.hpp"
 #include "imgui/imgui.h"
@@ -18,6 +19,7 @@
 #include "imgui/imgui_impl_sdlrenderer2.h"
 #include <Gui.h>
 #include <SDL.h>
+#include <algorithm>
 #include <filesystem>
 
 char* n_ram_buffer = 0;
@@ -36,10 +38,61 @@ std::vector<UIWindow*> windows{};
 
 static ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
+/*
+ * The debugger is only rebuilt when something could have changed what it shows: for a few frames
+ * after input (ImGui needs those to settle hover and layout), while the mouse is held, and when
+ * the emulation state moved. Otherwise it falls back to a slow refresh, slower still when its
+ * window is hidden or minimized.
+ */
+static const int refresh_settle_frames = 3;
+static const Uint32 refresh_running_ms = 50;
+static const Uint32 refresh_idle_ms = 250;
+static const Uint32 refresh_hidden_ms = 1000;
+static int settle_frames = refresh_settle_frames;
+static Uint64 last_refresh = 0;
+static uint64_t last_instructions = 0;
+static bool last_paused = false;
+
+static Uint32 gui_refresh_interval() {
+	if (SDL_GetWindowFlags(window) & (SDL_WINDOW_HIDDEN | SDL_WINDOW_MINIMIZED))
+		return refresh_hidden_ms;
+	if (m_emu->chipset.cpu.snapshot.Load().instructions != last_instructions || m_emu->GetPaused() != last_paused)
+		return refresh_running_ms;
+	return refresh_idle_ms;
+}
+
+void gui_invalidate() {
+	settle_frames = refresh_settle_frames;
+}
+
+int gui_refresh_timeout() {
+	if (!ImGui::GetCurrentContext())
+		return -1;
+	if (settle_frames > 0)
+		return 0;
+	Uint64 elapsed = (SDL_GetPerformanceCounter() - last_refresh) * 1000 / SDL_GetPerformanceFrequency();
+	Uint32 interval = gui_refresh_interval();
+	return elapsed >= interval ? 0 : (int)(interval - elapsed);
+}
+
 void gui_loop() {
 	if (!m_emu->Running())
 		return;
 
+	if (gui_refresh_timeout() != 0) {
+#ifdef SINGLE_WINDOW
+		// The main window was cleared, draw the last debugger frame again.
+		if (ImGui::GetDrawData())
+			ImGui_ImplSDLRenderer2_RenderDrawData(ImGui::GetDrawData());
+#endif
+		return;
+	}
+	last_refresh = SDL_GetPerformanceCounter();
+	last_instructions = m_emu->chipset.cpu.snapshot.Load().instructions;
+	last_paused = m_emu->GetPaused();
+	if (settle_frames > 0)
+		--settle_frames;
+
 	ImGuiIO& io = ImGui::GetIO();
 
 	ImGui_ImplSDLRenderer2_NewFrame();
@@ -79,6 +132,8 @@ void gui_loop() {
 	ImGui::End();
 #endif
 	ImGui::Render();
+	if (ImGui::IsAnyMouseDown())
+		settle_frames = std::max(settle_frames, 1);
 	// SDL_RenderSetScale(renderer, io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
 #ifdef SINGLE_WINDOW
 	ImGui_ImplSDLRenderer2_RenderDrawData(ImGui::GetDrawData());
@@ -114,8 +169,10 @@ int test_gui(bool* guiCreated, SDL_Window* wnd, SDL_Renderer* rnd) {
 	ImGui_ImplSDLRenderer2_Init(renderer);
 	if (guiCreated)
 		*guiCreated = true;
-	while (!me_mmu)
-		std::this_thread::sleep_for(std::chrono::microseconds(1));
+	// The debugger shows the instance in `m_emu`.
+	me_mmu = &m_emu->chipset.mmu;
+	if (auto ram = m_emu->chipset.QueryInterface<IRam>())
+		n_ram_buffer = (char*)ram->GetRam();
 
 	g_labels = parseFile(m_emu->GetModelFilePath("labels"));
 
@@ -17,14 +17,14 @@
 
 void WatchWindow::PrepareRX() {
 	for (int i = 0; i < 16; i++) {
-		sprintf((char*)reg_rx[i], "%02x", m_emu->chipset.cpu.reg_r[i] & 0x0ff);
+		sprintf((char*)reg_rx[i], "%02x", regs.reg_r[i] & 0x0ff);
 	}
-	sprintf(reg_pc, "%05x", (uint32_t)(m_emu->chipset.cpu.reg_csr << 16) | m_emu->chipset.cpu.reg_pc);
-	sprintf(reg_lr, "%05x", (uint32_t)(m_emu->chipset.cpu.reg_lcsr << 16) | m_emu->chipset.cpu.reg_lr);
-	sprintf(reg_sp, "%04x", m_emu->chipset.cpu.reg_sp | 0);
-	sprintf(reg_ea, "%04x", m_emu->chipset.cpu.reg_ea | 0);
-	sprintf(reg_psw, "%02x", m_emu->chipset.cpu.reg_psw | 0);
-	sprintf(reg_dsr, "%02x", m_emu->chipset.cpu.reg_dsr | 0);
+	sprintf(reg_pc, "%05x", regs.GetPC());
+	sprintf(reg_lr, "%05x", regs.GetLR());
+	sprintf(reg_sp, "%04x", regs.reg_sp | 0);
+	sprintf(reg_ea, "%04x", regs.reg_ea | 0);
+	sprintf(reg_psw, "%02x", regs.reg_psw | 0);
+	sprintf(reg_dsr, "%02x", regs.reg_dsr | 0);
 }
 
 void WatchWindow::ShowRX() {
@@ -39,9 +39,9 @@ void WatchWindow::ShowRX() {
 	ImGui::TextUnformatted("ERn: ");
 	for (int i = 0; i < 16; i += 2) {
 		ImGui::SameLine();
-		uint16_t val = m_emu->chipset.cpu.reg_r[i + 1]
+		uint16_t val = regs.reg_r[i + 1]
 						   << 8 |
-					   m_emu->chipset.cpu.reg_r[i];
+					   regs.reg_r[i];
 		ImGui::Text("%04x ", val);
 	}
 	auto show_sfr = ([&](char* ptr, const char* label, int i, int width = 4) {
@@ -63,23 +63,24 @@ void WatchWindow::ShowRX() {
 	ImGui::SameLine();
 	show_sfr(reg_dsr, "DSR: ", 6, 2);
 }
-void WatchWindow::ModRX() {
+bool WatchWindow::ModRX() {
 	char id[10];
+	bool changed = false;
 	ImGui::TextColored(ImVec4(0, 200, 0, 255), "RXn: ");
 	for (int i = 0; i < 16; i++) {
 		ImGui::SameLine();
 		sprintf(id, "##data%d", i);
 		ImGui::SetNextItemWidth(char_width * 3);
-		ImGui::InputText(id, (char*)&reg_rx[i][0], 3, ImGuiInputTextFlags_CharsHexadecimal);
+		changed |= ImGui::InputText(id, (char*)&reg_rx[i][0], 3, ImGuiInputTextFlags_CharsHexadecimal);
 	}
 	// ERn
 	// 不可编辑，必须通过Rn编辑
 	ImGui::TextUnformatted("ERn: ");
 	for (int i = 0; i < 16; i += 2) {
 		ImGui::SameLine();
-		uint16_t val = m_emu->chipset.cpu.reg_r[i + 1]
+		uint16_t val = regs.reg_r[i + 1]
 						   << 8 |
-					   m_emu->chipset.cpu.reg_r[i];
+					   regs.reg_r[i];
 		ImGui::Text("%04x ", val);
 	}
 
@@ -88,7 +89,7 @@ void WatchWindow::ModRX() {
 		ImGui::SameLine();
 		sprintf(id, "##sfr%d", i);
 		ImGui::SetNextItemWidth(char_width * width + 2);
-		ImGui::InputText(id, (char*)ptr, width + 1, ImGuiInputTextFlags_CharsHexadecimal);
+		changed |= ImGui::InputText(id, (char*)ptr, width + 1, ImGuiInputTextFlags_CharsHexadecimal);
 	});
 	show_sfr(reg_pc, "PC: ", 1, 6);
 	ImGui::SameLine();
@@ -101,21 +102,36 @@ void WatchWindow::ModRX() {
 	show_sfr(reg_psw, "PSW: ", 5, 2);
 	ImGui::SameLine();
 	show_sfr(reg_dsr, "DSR: ", 6, 2);
+	return changed;
 }
 
 void WatchWindow::UpdateRX() {
+	// Parse here, assign on the tick thread.
+	casioemu::CPU::Snapshot edited = regs;
 	for (int i = 0; i < 16; i++) {
-		m_emu->chipset.cpu.reg_r[i] = (uint8_t)strtol((char*)reg_rx[i], nullptr, 16);
+		edited.reg_r[i] = (uint8_t)strtol((char*)reg_rx[i], nullptr, 16);
 	}
 	auto pc = strtol((char*)reg_pc, nullptr, 16);
-	m_emu->chipset.cpu.reg_pc = (uint16_t)pc;
-	m_emu->chipset.cpu.reg_csr = pc >> 16;
-	 pc = strtol((char*)reg_lr, nullptr, 16);
-	m_emu->chipset.cpu.reg_lr = (uint16_t)pc;
-	m_emu->chipset.cpu.reg_lcsr = pc >> 16;
-	m_emu->chipset.cpu.reg_ea = (uint16_t)strtol((char*)reg_ea, nullptr, 16);
-	m_emu->chipset.cpu.reg_sp = (uint16_t)strtol((char*)reg_sp, nullptr, 16);
-	m_emu->chipset.cpu.reg_psw = (uint16_t)strtol((char*)reg_psw, nullptr, 16);
+	edited.reg_pc = (uint16_t)pc;
+	edited.reg_csr = pc >> 16;
+	pc = strtol((char*)reg_lr, nullptr, 16);
+	edited.reg_lr = (uint16_t)pc;
+	edited.reg_lcsr = pc >> 16;
+	edited.reg_ea = (uint16_t)strtol((char*)reg_ea, nullptr, 16);
+	edited.reg_sp = (uint16_t)strtol((char*)reg_sp, nullptr, 16);
+	edited.reg_psw = (uint16_t)strtol((char*)reg_psw, nullptr, 16);
+	m_emu->Post([edited] {
+		auto& cpu = m_emu->chipset.cpu;
+		for (int i = 0; i < 16; i++)
+			cpu.reg_r[i] = edited.reg_r[i];
+		cpu.reg_pc = edited.reg_pc;
+		cpu.reg_csr = edited.reg_csr;
+		cpu.reg_lr = edited.reg_lr;
+		cpu.reg_lcsr = edited.reg_lcsr;
+		cpu.reg_ea = edited.reg_ea;
+		cpu.reg_sp = edited.reg_sp;
+		cpu.reg_psw = edited.reg_psw;
+	});
 }
 inline static std::string lookup_symbol(uint32_t addr) {
 	auto iter = std::lower_bound(g_labels.begin(), g_labels.end(), addr,
@@ -140,9 +156,10 @@ inline static std::string lookup_symbol(uint32_t addr) {
 }
 void WatchWindow::RenderCore() {
 	char_width = ImGui::CalcTextSize("F").x;
-	casioemu::Chipset& chipset = m_emu->chipset;
+	m_emu->chipset.cpu.snapshot.Load(regs);
+	m_emu->chipset.cpu.stack_snapshot.Load(stack);
 	ImGui::BeginChild("##reg_trace", ImVec2(0, ImGui::GetTextLineHeightWithSpacing() * 4 + ImGui::GetStyle().ItemInnerSpacing.y * 4), false, 0);
-	auto rm = m_emu->chipset.run_mode;
+	auto rm = regs.run_mode;
 	using casioemu::Chipset::RM_HALT;
 	using casioemu::Chipset::RM_RUN;
 	using casioemu::Chipset::RM_STOP;
@@ -182,14 +199,15 @@ void WatchWindow::RenderCore() {
 	if (!m_emu->GetPaused()) {
 		ShowRX();
 		if (ImGui::Button("Pause")) {
-			m_emu->SetPaused(1);
+			m_emu->Post([] { m_emu->SetPaused(true); });
 		}
 	}
 	else {
-		ModRX();
-		UpdateRX();
+		// Only write back what was edited, the snapshot may lag behind the registers.
+		if (ModRX())
+			UpdateRX();
 		if (ImGui::Button("Continue")) {
-			m_emu->SetPaused(0);
+			m_emu->Post([] { m_emu->SetPaused(false); });
 		}
 	}
 
@@ -205,20 +223,8 @@ void WatchWindow::RenderCore() {
 		ImGui::TableSetupColumn("ER2", ImGuiTableColumnFlags_WidthFixed, 40);
 		ImGui::TableSetupColumn("LR", ImGuiTableColumnFlags_WidthStretch, 1);
 		ImGui::TableHeadersRow();
-		auto stack = chipset.cpu.stack.get();
-		class reverse_view {
-		public:
-			reverse_view(decltype(*stack)& vector1) : stk(vector1) {}
-			decltype(*stack)& stk;
-			auto begin() {
-				return stk.rbegin();
-			}
-			auto end() {
-				return stk.rend();
-			}
-		};
-
-		for (auto& frame : reverse_view{*stack}) {
+		for (size_t i = stack.count; i--;) {
+			auto& frame = stack.frames[i];
 			ImGui::TableNextRow();
 			ImGui::TableNextColumn();
 			ImGui::TextUnformatted(lookup_symbol(frame.new_pc).c_str());
@@ -242,6 +248,8 @@ void WatchWindow::RenderCore() {
 		}
 		ImGui::EndTable();
 	}
+	if (stack.depth > stack.count)
+		ImGui::TextDisabled("... %zu more", stack.depth - stack.count);
 	ImGui::EndChild();
 	ImGui::BeginChild("##stack_view");
 	ImGui::Text(
@@ -253,12 +261,12 @@ void WatchWindow::RenderCore() {
 	);
 	ImGui::SameLine();
 	ImGui::SliderInt("##range", &range, 64, 2048);
-	uint16_t offset = chipset.cpu.reg_sp & 0xffff;
+	uint16_t offset = regs.reg_sp & 0xffff;
 	mem_editor.ReadFn = [](const ImU8* data, size_t off) -> ImU8 {
 		return me_mmu->ReadData((size_t)data + off);
 	};
 	mem_editor.WriteFn = [](ImU8* data, size_t off, ImU8 d) {
-		return me_mmu->WriteData((size_t)data + off, d);
+		m_emu->Post([addr = (size_t)data + off, d] { me_mmu->WriteData(addr, d); });
 	};
 	auto rng = range;
 	if (rng + offset >= casioemu::GetRamBaseAddr(m_emu->hardware_id) + casioemu::GetRamSize(m_emu->hardware_id)) {
@@ -1,5 +1,6 @@
 ﻿#pragma once
 
+#include "Chipset/CPU.hpp"
 #include "Emulator.hpp"
 #include "Ui.hpp"
 #include "hex.hpp"
@@ -11,6 +12,9 @@ private:
 	char reg_lr[10], reg_sp[5], reg_ea[10], reg_pc[10], reg_psw[3], reg_dsr[3];
 	int char_width;
 	MemoryEditor mem_editor;
+	// Loaded from the CPU snapshots once per frame.
+	casioemu::CPU::Snapshot regs{};
+	casioemu::CPU::StackSnapshot stack{};
 
 public:
 	WatchWindow() : UIWindow("Watch"){};
@@ -20,7 +24,7 @@ public:
 	void ShowRX();
 
 	void PrepareRX();
-	void ModRX();
+	bool ModRX();
 
 	void UpdateRX();
 };
\ No newline at end of file
@@ -6,6 +6,12 @@
 int test_gui(bool* guiCreated,SDL_Window*,SDL_Renderer*);
 void gui_cleanup();
 void gui_loop();
+// Marks the debugger for redraw, call on every input event.
+void gui_invalidate();
+// Milliseconds until the debugger wants to be redrawn, 0 if now, -1 if never.
+int gui_refresh_timeout();
+// The instance the debugger windows show. Only the UI sets and uses these, the emulator core
+// keeps everything per instance.
 extern char* n_ram_buffer;
 extern casioemu::MMU* me_mmu;
 extern casioemu::Emulator* m_emu;
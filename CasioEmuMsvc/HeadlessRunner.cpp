@@ -0,0 +1,146 @@
+﻿#include "HeadlessRunner.hpp"
+
+#include "Chipset/Chipset.hpp"
+#include "Emulator.hpp"
+#include "Logger.hpp"
+#include "Peripheral/Keyboard.hpp"
+#include "Peripheral/Screen.hpp"
+#include "RewindBuffer.hpp"
+
+#include <SDL_image.h>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace casioemu {
+	HeadlessRunner::HeadlessRunner(Emulator& _emulator) : emulator(_emulator) {
+	}
+
+	void HeadlessRunner::WaitEmulated(double seconds) {
+		auto ticks = emulator.Query([&] { return (Uint64)(seconds * emulator.GetCyclesPerSecond() + 0.5); }).get();
+		emulator.RunFor(ticks).wait();
+	}
+
+	bool HeadlessRunner::Press(std::function<bool(IKeyboard&)> press) {
+		bool pressed = emulator.Call([&] {
+			auto keyboard = emulator.chipset.QueryInterface<IKeyboard>();
+			return keyboard && press(*keyboard);
+		}).get();
+		if (!pressed)
+			return false;
+		WaitEmulated(hold_seconds);
+		emulator.Post([this] {
+			if (auto keyboard = emulator.chipset.QueryInterface<IKeyboard>())
+				keyboard->ReleaseAll();
+		});
+		WaitEmulated(hold_seconds);
+		return true;
+	}
+
+	bool HeadlessRunner::ReadScreen(std::vector<uint32_t>& pixels, int& width, int& height) {
+		return emulator.Query([&] {
+			auto framebuffer = emulator.chipset.QueryInterface<IFramebuffer>();
+			if (!framebuffer)
+				return false;
+			framebuffer->ReadFramebuffer(pixels, width, height);
+			return true;
+		}).get();
+	}
+
+	bool HeadlessRunner::Screenshot(const std::string& path) {
+		std::vector<uint32_t> pixels;
+		int width = 0, height = 0;
+		if (!ReadScreen(pixels, width, height))
+			return false;
+
+		// Flatten onto white, like a recording without the calculator body.
+		SDL_Surface* lcd = SDL_CreateRGBSurfaceWithFormatFrom(pixels.data(), width, height, 32, width * sizeof(uint32_t), SDL_PIXELFORMAT_ARGB8888);
+		SDL_Surface* image = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+		bool saved = false;
+		if (lcd && image) {
+			SDL_FillRect(image, nullptr, 0xFFFFFFFF);
+			SDL_SetSurfaceBlendMode(lcd, SDL_BLENDMODE_BLEND);
+			SDL_BlitSurface(lcd, nullptr, image, nullptr);
+			saved = IMG_SavePNG(image, path.c_str()) == 0;
+		}
+		if (lcd)
+			SDL_FreeSurface(lcd);
+		if (image)
+			SDL_FreeSurface(image);
+		return saved;
+	}
+
+	bool HeadlessRunner::Execute(const std::string& line) {
+		std::istringstream iss(line);
+		std::string command, argument;
+		iss >> command;
+		std::getline(iss >> std::ws, argument);
+		if (command.empty() || command[0] == '#')
+			return true;
+		if (command == "key")
+			return Press([&](IKeyboard& keyboard) { return keyboard.PressKeyName(argument.c_str()); });
+		if (command == "code") {
+			auto code = (uint8_t)std::strtoul(argument.c_str(), nullptr, 16);
+			return Press([code](IKeyboard& keyboard) {
+				keyboard.PressButtonByCode(code);
+				return true;
+			});
+		}
+		if (command == "hold") {
+			hold_seconds = std::atof(argument.c_str()) / 1000;
+			return true;
+		}
+		if (command == "wait") {
+			WaitEmulated(std::atof(argument.c_str()) / 1000);
+			return true;
+		}
+		if (command == "screenshot")
+			return Screenshot(argument);
+		if (command == "save")
+			return emulator.Query([&] { return emulator.SaveStateFile(argument); }).get();
+		if (command == "load")
+			return emulator.Call([&] { return emulator.LoadStateFile(argument); }).get();
+		if (command == "rewind") {
+			double seconds = std::atof(argument.c_str()) / 1000;
+			return emulator.Call([&] { return emulator.rewind && emulator.rewind->Rewind(seconds); }).get();
+		}
+		if (command == "quit") {
+			emulator.Shutdown();
+			return true;
+		}
+		return false;
+	}
+
+	int HeadlessRunner::Run() {
+		auto input = emulator.argv_map.find("input");
+		if (input == emulator.argv_map.end()) {
+			while (emulator.Running())
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			return 0;
+		}
+
+		std::ifstream file;
+		std::istream* in = &std::cin;
+		if (input->second != "-") {
+			file.open(input->second);
+			if (!file)
+				PANIC("Cannot open input '%s'\n", input->second.c_str());
+			in = &file;
+		}
+
+		std::string line;
+		size_t line_number = 0;
+		while (emulator.Running() && std::getline(*in, line)) {
+			++line_number;
+			if (!Execute(line)) {
+				logger::Info("[Headless][Error] Line %zu failed: %s\n", line_number, line.c_str());
+				return 1;
+			}
+		}
+		return 0;
+	}
+} // namespace casioemu
@@ -0,0 +1,62 @@
+﻿#pragma once
+#include "Config.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class IKeyboard;
+
+namespace casioemu {
+	class Emulator;
+
+	/**
+	 * Drives an emulator started with `headless`. Commands are read one per line from the file
+	 * named by the `input` argument, or from stdin if it's "-" so a pipe works too, and the
+	 * emulator stops when the input ends. Without `input` it runs until the process is killed.
+	 * With `input` the emulator starts paused, in turbo mode, and only runs during `key`, `code`
+	 * and `wait`, each time for an exact number of ticks (Emulator::RunFor). Turbo clocks the EMUCLK
+	 * tick and the TI key wait from emulated cycles, so a script ends on the same machine whatever
+	 * the host's speed. Without it the emulator runs freely.
+	 *
+	 *   key <name>         press and release the button bound to host key <name> (an SDL key name)
+	 *   code <hex>         press and release the button with KI/KO code <hex>
+	 *   hold <ms>          how long keys stay down and up, 100 by default
+	 *   wait <ms>          let <ms> pass
+	 *   screenshot <file>  save the LCD as a PNG
+	 *   save <file>        write a save state of the whole machine
+	 *   load <file>        continue from a save state
+	 *   rewind <ms>        go back at least <ms> of emulated time, needs the `rewind=<MB>` argument
+	 *   quit
+	 *
+	 * Empty lines and lines starting with '#' are skipped.
+	 */
+	class HeadlessRunner {
+		Emulator& emulator;
+		double hold_seconds = 0.1;
+
+		bool Press(std::function<bool(IKeyboard&)> press);
+		bool Screenshot(const std::string& path);
+
+	public:
+		HeadlessRunner(Emulator& emulator);
+
+		/**
+		 * Runs one command line as described above. Returns false if it failed or is unknown.
+		 */
+		bool Execute(const std::string& line);
+		/**
+		 * Runs the emulator for exactly `seconds` of emulated time and leaves it paused, see Emulator::RunFor.
+		 */
+		void WaitEmulated(double seconds);
+		/**
+		 * Reads the LCD through IFramebuffer. Returns false if the model has no screen.
+		 */
+		bool ReadScreen(std::vector<uint32_t>& pixels, int& width, int& height);
+
+		/**
+		 * Returns the process exit code, 1 if a command failed.
+		 */
+		int Run();
+	};
+} // namespace casioemu
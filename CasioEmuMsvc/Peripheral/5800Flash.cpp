@@ -49,7 +49,7 @@ namespace casioemu {
 						break;
 					case 3:
 						// printf("Program %x to %x\n", (int)fo, data);
-						flash->emulator.chipset.flash_data[fo] = data;
+						flash->emulator.chipset.flash_data.MakeWritable(fo, 1)[fo] = data;
 						flash->flash_mode = 0;
 						return;
 					case 4:
@@ -66,9 +66,9 @@ namespace casioemu {
 						break;
 					case 6: // we dont know sector's mapping(?)
 						if (fo == 0)
-							memset(&flash->emulator.chipset.flash_data[fo], 0xff, 0x7fff);
+							memset(flash->emulator.chipset.flash_data.MakeWritable(fo, 0x7fff) + fo, 0xff, 0x7fff);
 						if (fo == 0x20000 || fo == 0x30000)
-							memset(&flash->emulator.chipset.flash_data[fo], 0xff, 0xffff);
+							memset(flash->emulator.chipset.flash_data.MakeWritable(fo, 0xffff) + fo, 0xff, 0xffff);
 						// printf("Erase %x (%x)\n", (int)fo, data);
 						return;
 					case 7:
@@ -95,6 +95,12 @@ namespace casioemu {
 				},
 				emulator);
 		}
+		void SaveState(std::ostream& os) override {
+			Binary::Write(os, flash_mode);
+		}
+		void LoadState(std::istream& is) override {
+			Binary::Read(is, flash_mode);
+		}
 	};
 	Peripheral* CreateFx5800Flash(Emulator& emu) {
 		return new Flash2(emu);
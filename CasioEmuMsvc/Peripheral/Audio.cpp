@@ -88,18 +88,20 @@ namespace casioemu {
 		}
 	public:
 		AudioDriver(Emulator& emu) : Peripheral(emu) {
-			SDL_Init(SDL_INIT_AUDIO);
+			if (!emulator.headless) {
+				SDL_Init(SDL_INIT_AUDIO);
 
-			SDL_AudioSpec desired_spec{};
-			desired_spec.freq = 44100;
-			desired_spec.format = AUDIO_S16SYS;
-			desired_spec.channels = 1;
-			desired_spec.samples = 64;
-			desired_spec.userdata = this;
-			desired_spec.callback = audio_callback;
+				SDL_AudioSpec desired_spec{};
+				desired_spec.freq = 44100;
+				desired_spec.format = AUDIO_S16SYS;
+				desired_spec.channels = 1;
+				desired_spec.samples = 64;
+				desired_spec.userdata = this;
+				desired_spec.callback = audio_callback;
 
-			audio_device = SDL_OpenAudioDevice(
-				NULL, 0, &desired_spec, NULL, 0);
+				audio_device = SDL_OpenAudioDevice(
+					NULL, 0, &desired_spec, NULL, 0);
+			}
 			block_bit = 4;
 			MD0CON.Setup(0xF2C0, 1, "Buzzer/MD0CON", &control, MMURegion::DefaultRead<uint8_t, 0x1>, MMURegion::DefaultWrite<uint8_t, 0x1>, emulator);
 			MD0TMP.Setup(0xF2C1, 1, "Buzzer/MD0TMP", &tempo, MMURegion::DefaultRead<uint8_t, 0x3>, MMURegion::DefaultWrite<uint8_t, 0x3>, emulator);
@@ -107,12 +109,20 @@ namespace casioemu {
 		}
 		SDL_AudioDeviceID audio_device{};
 		void Initialise() override {
-			SDL_PauseAudioDevice(audio_device, 0);
+			if (audio_device)
+				SDL_PauseAudioDevice(audio_device, 0);
 		}
 		void Tick() override {
 		}
 		void Uninitialise() override {
-			SDL_PauseAudioDevice(audio_device, 1);
+			if (audio_device)
+				SDL_PauseAudioDevice(audio_device, 1);
+		}
+		void SaveState(std::ostream& os) override {
+			Binary::WriteAll(os, control, tempo, length);
+		}
+		void LoadState(std::istream& is) override {
+			Binary::ReadAll(is, control, tempo, length);
 		}
 	};
 	Peripheral* CreateBuzzerDriver(Emulator& emu) {
@@ -55,6 +55,8 @@ namespace casioemu {
 		void ShiftLeft(int param);
 		void ShiftRight(int param);
 		void DataOperate();
+		void SaveState(std::ostream& os) override;
+		void LoadState(std::istream& is) override;
 	};
 	void BCDCalc::Initialise() {
 		if (emulator.hardware_id != HW_CLASSWIZ_II)
@@ -1124,6 +1126,16 @@ namespace casioemu {
 		data_F404 = 0;
 		data_F405 = 0;
 	}
+
+	void BCDCalc::SaveState(std::ostream& os) {
+		Binary::WriteAll(os, data_F400, data_F402, data_F404, data_F405, data_F410, data_F414, data_F415, data_datas, F400_write, F402_write, F404_write, F405_write);
+		Binary::WriteAll(os, data_operator, data_type_1, data_type_2, param1, param2, param3, param4, data_F404_copy, data_mode, data_repeat_flag, data_a, data_b, data_c, data_d, data_F402_copy, data_F405_copy);
+	}
+
+	void BCDCalc::LoadState(std::istream& is) {
+		Binary::ReadAll(is, data_F400, data_F402, data_F404, data_F405, data_F410, data_F414, data_F415, data_datas, F400_write, F402_write, F404_write, F405_write);
+		Binary::ReadAll(is, data_operator, data_type_1, data_type_2, param1, param2, param3, param4, data_F404_copy, data_mode, data_repeat_flag, data_a, data_b, data_c, data_d, data_F402_copy, data_F405_copy);
+	}
 	Peripheral* CreateBcdCalc(Emulator& emu) {
 		return new BCDCalc(emu);
 	}
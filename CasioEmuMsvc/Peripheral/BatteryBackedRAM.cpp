@@ -2,17 +2,19 @@
 #include "Chipset/Chipset.hpp"
 #include "Chipset/MMU.hpp"
 #include "Emulator.hpp"
-#include "Gui/Ui.hpp"
 #include "Logger.hpp"
 #include "ModelInfo.h"
 #include "Models.h"
+#include <algorithm>
 #include <cstring>
 #include <fstream>
+#include <random>
 
-inline void fillRandomData(unsigned char* buf, size_t size) {
-	std::srand(static_cast<unsigned int>(SDL_GetPerformanceCounter())); // 使用当前时间作为随机种子
-	std::generate(buf, buf + size, []() {
-		return static_cast<unsigned char>(std::rand() % 256); // 生成0到255之间的随机数
+inline void fillRandomData(unsigned char* buf, size_t size, unsigned int seed) {
+	// A generator of its own, std::rand is shared by every emulator in the process. See Emulator::NextRandomSeed.
+	std::minstd_rand rng(seed);
+	std::generate(buf, buf + size, [&]() {
+		return static_cast<unsigned char>(rng() % 256); // 生成0到255之间的随机数
 	});
 }
 
@@ -22,6 +24,7 @@ namespace casioemu {
 
 		size_t ram_size{};
 		bool ram_file_requested{};
+		std::vector<Range> ranges;
 
 	public:
 		using Peripheral::Peripheral;
@@ -39,6 +42,9 @@ namespace casioemu {
 		void* GetPRam() override {
 			return pram_buffer;
 		}
+		const std::vector<Range>& GetRanges() override {
+			return ranges;
+		}
 		virtual void* QueryInterface(const char* name) override{
 			if (strcmp(name, typeid(IRam).name()) == 0) {
 				return (IRam*)this;
@@ -53,7 +59,7 @@ namespace casioemu {
 			ram_size += 0x100;
 
 		ram_buffer = new uint8_t[ram_size];
-		fillRandomData(ram_buffer, ram_size);
+		fillRandomData(ram_buffer, ram_size, emulator.NextRandomSeed());
 
 		ram_file_requested = false;
 		if (emulator.argv_map.find("ram") != emulator.argv_map.end()) {
@@ -69,7 +75,7 @@ namespace casioemu {
 			"BatteryBackedRAM", ram_buffer, [](MMURegion* region, size_t offset) { return ((uint8_t*)region->userdata)[offset - region->base]; }, [](MMURegion* region, size_t offset, uint8_t data) { ((uint8_t*)region->userdata)[offset - region->base] = data; }, emulator);
 		if (emulator.hardware_id == HW_FX_5800P) {
 			pram_buffer = new uint8_t[0x8000];
-			fillRandomData(pram_buffer, 0x8000);
+			fillRandomData(pram_buffer, 0x8000, emulator.NextRandomSeed());
 			region_5.Setup(
 				0x40000,
 				0x8000,
@@ -81,9 +87,13 @@ namespace casioemu {
 																								  : 0x89800,
 				0x0100,
 				"BatteryBackedRAM/2", ram_buffer + ram_size - 0x100, [](MMURegion* region, size_t offset) { return ((uint8_t*)region->userdata)[offset - region->base]; }, [](MMURegion* region, size_t offset, uint8_t data) { ((uint8_t*)region->userdata)[offset - region->base] = data; }, emulator);
-
-		n_ram_buffer = (char*)ram_buffer;
 		// logger::Info("inited hex editor!\n");
+
+		ranges = {{region.base, ram_buffer, region.size}};
+		if (pram_buffer)
+			ranges.push_back({region_5.base, pram_buffer, region_5.size});
+		if (!real_hardware)
+			ranges.push_back({region_2.base, ram_buffer + ram_size - 0x100, region_2.size});
 	}
 
 	void BatteryBackedRAM::Uninitialise() {
@@ -118,6 +128,7 @@ namespace casioemu {
 			return;
 		}
 	}
+
 	Peripheral* CreateBatteryBackedRAM(Emulator& emu) {
 		return new BatteryBackedRAM(emu);
 	}
@@ -1,4 +1,8 @@
 ﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 namespace casioemu {
 	class Peripheral* CreateBatteryBackedRAM(class Emulator& emu);
 }
@@ -6,4 +10,13 @@ class IRam {
 public:
 	virtual void* GetRam() = 0;
 	virtual void* GetPRam() = 0;
+	/**
+	 * A RAM buffer where the MMU maps it. Save states and rewind checkpoints copy RAM through these.
+	 */
+	struct Range {
+		size_t base;
+		uint8_t* data;
+		size_t size;
+	};
+	virtual const std::vector<Range>& GetRanges() = 0;
 };
\ No newline at end of file
@@ -8,7 +8,7 @@
 namespace casioemu
 {
     void ExternalInterrupts::Initialise() {
-        clock_type = CLOCK_UNDEFINED;
+        SetClockType(CLOCK_UNDEFINED);
 
         emulator.chipset.data_EXICON = 0;
 
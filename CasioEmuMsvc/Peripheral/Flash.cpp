@@ -13,6 +13,12 @@ namespace casioemu {
 				data_flash_segment = 0;
 		int flashing_status = 0;
 		void Initialise() override;
+		void SaveState(std::ostream& os) override {
+			Binary::WriteAll(os, data_flash_addr, data_flash_data, data_flash_control, data_flash_segment, flashing_status);
+		}
+		void LoadState(std::istream& is) override {
+			Binary::ReadAll(is, data_flash_addr, data_flash_data, data_flash_control, data_flash_segment, flashing_status);
+		}
 
 	public:
 		Flash(Emulator& emulator) : Peripheral(emulator) {
@@ -45,9 +51,11 @@ void casioemu::Flash::Initialise() {
 			}
 			if (offset == 0xf0e3 && flash->flashing_status == 2) {
 				auto index = (flash->data_flash_segment << 16) | flash->data_flash_addr;
-				if (index <= region->emulator->chipset.rom_data.size() - 2) {
-					*((uint8_t*)&region->emulator->chipset.rom_data[index]) = flash->data_flash_data & 0xff;
-					*((uint8_t*)&region->emulator->chipset.rom_data[index + 1]) = flash->data_flash_data >> 8;
+				auto& rom = region->emulator->chipset.rom_data;
+				if (index <= rom.size() - 2) {
+					auto data = rom.MakeWritable(index, 2);
+					data[index] = flash->data_flash_data & 0xff;
+					data[index + 1] = flash->data_flash_data >> 8;
 				}
 				flash->flashing_status = 0;
 			}
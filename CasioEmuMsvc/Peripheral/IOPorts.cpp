@@ -5,7 +5,6 @@
 #include "Chipset/CPU.hpp"
 #include "Emulator.hpp"
 #include "Logger.hpp"
-#include "Gui/Ui.hpp"
 
 namespace casioemu {
 	void IOPorts::Initialise() {
@@ -178,4 +177,12 @@ namespace casioemu {
 			emulator.chipset.Port1Outputlevel[i] = false;
 		}
 	}
+
+	void IOPorts::SaveState(std::ostream& os) {
+		Binary::WriteAll(os, port0_mode, port0_control_0, port0_control_1, port0_direction, port0_unk, port1_mode_0, port1_mode_1, port1_control_0, port1_control_1, port1_direction, port0_output, port1_output);
+	}
+
+	void IOPorts::LoadState(std::istream& is) {
+		Binary::ReadAll(is, port0_mode, port0_control_0, port0_control_1, port0_direction, port0_unk, port1_mode_0, port1_mode_1, port1_control_0, port1_control_1, port1_direction, port0_output, port1_output);
+	}
 } // namespace casioemu
\ No newline at end of file
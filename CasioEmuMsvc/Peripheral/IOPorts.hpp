@@ -38,5 +38,7 @@ namespace casioemu {
 
 		void Initialise();
 		void Reset();
+		void SaveState(std::ostream& os) override;
+		void LoadState(std::istream& is) override;
 	};
 } // namespace casioemu
@@ -1,5 +1,6 @@
 ﻿#include "Keyboard.hpp"
 
+#include "BootCache.hpp"
 #include "Chipset/Chipset.hpp"
 #include "Chipset/MMU.hpp"
 #include "Emulator.hpp"
@@ -9,13 +10,14 @@
 #include <ML620Ports.h>
 #include <SDL.h>
 #include <chrono>
+#include <cstring>
 #include <fstream>
 #include <thread>
 #include <unordered_map>
 #include "vibration.h"
 
 namespace casioemu {
-	class Keyboard : public Peripheral {
+	class Keyboard : public Peripheral, public IKeyboard {
 		MMURegion region_ko_mask, region_ko, region_ki, region_input_mode, region_input_filter;
 		uint16_t keyboard_out, keyboard_out_mask;
 		uint8_t keyboard_in, input_mode, input_filter, keyboard_ghost[8], ki_ghost[8];
@@ -62,12 +64,21 @@ namespace casioemu {
 		void Uninitialise();
 		void PressButton(Button& button, bool stick);
 		void PressAt(int x, int y, bool stick);
-		void PressButtonByCode(uint8_t code);
+		void PressButtonByCode(uint8_t code) override;
+		bool PressKeyName(const char* name) override;
 		void StartInject();
 		void StoreKeyLog();
-		void ReleaseAll();
+		void ReleaseAll() override;
 		void RecalculateKI();
 		void RecalculateGhost();
+		void SaveState(std::ostream& os) override;
+		void LoadState(std::istream& is) override;
+		void* QueryInterface(const char* name) override {
+			if (strcmp(name, typeid(IKeyboard).name()) == 0) {
+				return (IKeyboard*)this;
+			}
+			return 0;
+		}
 	};
 	void Keyboard::Initialise() {
 		renderer = emulator.GetRenderer();
@@ -79,7 +90,7 @@ namespace casioemu {
 		 */
 		real_hardware = emulator.modeldef.real_hardware;
 
-		clock_type = CLOCK_UNDEFINED;
+		SetClockType(CLOCK_UNDEFINED);
 		if (emulator.hardware_id == HW_TI) {
 			auto pp = emulator.chipset.QueryInterface<IPortProvider>();
 			if (!pp)
@@ -430,7 +441,7 @@ namespace casioemu {
 				}
 				factory_test = !factory_test;
 				emulator.chipset.tiDiagMode = factory_test;
-				emulator.chipset.tiKey = 0xfe;
+				emulator.chipset.SetTIKey(0xfe);
 				printf("Factory test/Ti Diag status: %d\n", factory_test);
 				return;
 			}
@@ -456,6 +467,9 @@ namespace casioemu {
 		else
 			button.pressed = true;
 
+		if (button.pressed && emulator.boot_cache)
+			emulator.boot_cache->Cancel();
+
 		if (button.type == Button::BT_POWER && button.pressed && !old_pressed) {
 			if (!(emulator.hardware_id == HW_CLASSWIZ && (emulator.chipset.data_FCON & 0x03) == 0x03))
 				emulator.chipset.Reset();
@@ -470,7 +484,7 @@ namespace casioemu {
 				// if (!emulator.chipset.GetRunningState() && button.code == 0x29) {
 				//	emulator.chipset.Reset();
 				// }
-				emulator.chipset.tiKey = button.code;
+				emulator.chipset.SetTIKey(button.code);
 			}
 			printf("[Keyboard][Info] KI: %d, KO: %d\n", (int)(log(button.ki_bit) / log(2)), (int)(log(button.ko_bit) / log(2)));
 		}
@@ -521,6 +535,14 @@ namespace casioemu {
 		}
 	}
 
+	bool Keyboard::PressKeyName(const char* name) {
+		auto iterator = keyboard_map.find(SDL_GetKeyFromName(name));
+		if (iterator == keyboard_map.end())
+			return false;
+		PressButton(buttons[iterator->second], false);
+		return true;
+	}
+
 	void Keyboard::StartInject() {
 	}
 
@@ -675,6 +697,22 @@ namespace casioemu {
 				has_input = keyboard_in_emu = keyboard_out_emu = 0;
 		}
 	}
+
+	void Keyboard::SaveState(std::ostream& os) {
+		Binary::WriteAll(os, keyboard_out, keyboard_out_mask, keyboard_in, input_mode, input_filter, keyboard_ghost, ki_ghost, keyboard_in_last, input_filter_last);
+		Binary::WriteAll(os, keyboard_ready_emu, keyboard_out_emu, keyboard_in_emu, keyboard_pd_emu, emu_ki_readcount, emu_ko_readcount);
+		Binary::WriteAll(os, has_input, p0, p1, p146);
+		for (auto& button : buttons)
+			Binary::WriteAll(os, button.pressed, button.stuck);
+	}
+
+	void Keyboard::LoadState(std::istream& is) {
+		Binary::ReadAll(is, keyboard_out, keyboard_out_mask, keyboard_in, input_mode, input_filter, keyboard_ghost, ki_ghost, keyboard_in_last, input_filter_last);
+		Binary::ReadAll(is, keyboard_ready_emu, keyboard_out_emu, keyboard_in_emu, keyboard_pd_emu, emu_ki_readcount, emu_ko_readcount);
+		Binary::ReadAll(is, has_input, p0, p1, p146);
+		for (auto& button : buttons)
+			Binary::ReadAll(is, button.pressed, button.stuck);
+	}
 	Peripheral* CreateKeyboard(Emulator& emu) {
 		return new Keyboard(emu);
 	}
@@ -1,4 +1,22 @@
 ﻿#pragma once
+#include <cstdint>
 namespace casioemu {
 	class Peripheral* CreateKeyboard(class Emulator& emu);
-}
\ No newline at end of file
+}
+/**
+ * Key input without SDL events, for scripts and other front ends. Call on the emulation thread
+ * only, e.g. through Emulator::Post.
+ */
+class IKeyboard {
+public:
+	/**
+	 * Presses the button with KI/KO code `code`, as listed in the model's button table.
+	 */
+	virtual void PressButtonByCode(uint8_t code) = 0;
+	/**
+	 * Presses the button bound to the host key `name` (an SDL key name). Returns false if no
+	 * button is bound to it.
+	 */
+	virtual bool PressKeyName(const char* name) = 0;
+	virtual void ReleaseAll() = 0;
+};
\ No newline at end of file
@@ -0,0 +1,291 @@
+﻿#include "LcdKernel.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LCD_KERNEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LCD_TARGET_SSE2
+#define LCD_TARGET_AVX2
+#else
+#define LCD_TARGET_SSE2 __attribute__((target("sse2")))
+#define LCD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace casioemu {
+	struct LcdKernel {
+		const char* name;
+		void (*blend_row)(const uint8_t* plane0, const uint8_t* plane1, size_t bytes, float base, float weight0, float weight1, bool mirror, float* alpha, float keep);
+		void (*decay)(float* alpha, const float* target, size_t count, float keep);
+	};
+
+	// The per-dot loop Screen used before the kernels.
+	static void BlendRowScalar(const uint8_t* plane0, const uint8_t* plane1, size_t bytes, float base, float weight0, float weight1, bool mirror, float* alpha, float keep) {
+		float* dat = mirror ? alpha + bytes * 8 - 1 : alpha;
+		ptrdiff_t step = mirror ? -1 : 1;
+		for (size_t i = 0; i != bytes; ++i) {
+			for (uint8_t mask = 0x80; mask; mask >>= 1) {
+				float ink_alpha = base;
+				if (plane0[i] & mask)
+					ink_alpha += weight0;
+				if (plane1 && (plane1[i] & mask))
+					ink_alpha += weight1;
+				*dat = *dat * keep + ink_alpha * (1 - keep);
+				dat += step;
+			}
+		}
+	}
+
+	static void DecayScalar(float* alpha, const float* target, size_t count, float keep) {
+		if (!target) {
+			for (size_t i = 0; i != count; ++i)
+				alpha[i] *= keep;
+			return;
+		}
+		for (size_t i = 0; i != count; ++i)
+			alpha[i] = target[i] + (alpha[i] - target[i]) * keep;
+	}
+
+#ifdef LCD_KERNEL_X86
+	LCD_TARGET_SSE2 static void BlendRowSSE2(const uint8_t* plane0, const uint8_t* plane1, size_t bytes, float base, float weight0, float weight1, bool mirror, float* alpha, float keep) {
+		// Lane n of `bits_hi` / `bits_lo` selects the dot stored at n / n + 4 of the byte's 8 alphas.
+		const __m128i bits_hi = mirror ? _mm_set_epi32(0x08, 0x04, 0x02, 0x01) : _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+		const __m128i bits_lo = mirror ? _mm_set_epi32(0x80, 0x40, 0x20, 0x10) : _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+		const __m128 v_keep = _mm_set1_ps(keep), v_rest = _mm_set1_ps(1 - keep);
+		const __m128 v_base = _mm_set1_ps(base), v_weight0 = _mm_set1_ps(weight0), v_weight1 = _mm_set1_ps(weight1);
+		for (size_t i = 0; i != bytes; ++i) {
+			float* dat = alpha + (mirror ? bytes - 1 - i : i) * 8;
+			__m128i b = _mm_set1_epi32(plane0[i]);
+			__m128 hi = _mm_add_ps(v_base, _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(b, bits_hi), bits_hi)), v_weight0));
+			__m128 lo = _mm_add_ps(v_base, _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(b, bits_lo), bits_lo)), v_weight0));
+			if (plane1) {
+				b = _mm_set1_epi32(plane1[i]);
+				hi = _mm_add_ps(hi, _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(b, bits_hi), bits_hi)), v_weight1));
+				lo = _mm_add_ps(lo, _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(b, bits_lo), bits_lo)), v_weight1));
+			}
+			_mm_storeu_ps(dat, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(dat), v_keep), _mm_mul_ps(hi, v_rest)));
+			_mm_storeu_ps(dat + 4, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(dat + 4), v_keep), _mm_mul_ps(lo, v_rest)));
+		}
+	}
+
+	LCD_TARGET_SSE2 static void DecaySSE2(float* alpha, const float* target, size_t count, float keep) {
+		const __m128 v_keep = _mm_set1_ps(keep);
+		size_t i = 0;
+		if (!target) {
+			for (; i + 4 <= count; i += 4)
+				_mm_storeu_ps(alpha + i, _mm_mul_ps(_mm_loadu_ps(alpha + i), v_keep));
+		}
+		else {
+			for (; i + 4 <= count; i += 4) {
+				__m128 t = _mm_loadu_ps(target + i);
+				_mm_storeu_ps(alpha + i, _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(alpha + i), t), v_keep)));
+			}
+		}
+		DecayScalar(alpha + i, target ? target + i : nullptr, count - i, keep);
+	}
+
+	LCD_TARGET_AVX2 static void BlendRowAVX2(const uint8_t* plane0, const uint8_t* plane1, size_t bytes, float base, float weight0, float weight1, bool mirror, float* alpha, float keep) {
+		const __m256i bits = mirror ? _mm256_set_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01) : _mm256_set_epi32(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+		const __m256 v_keep = _mm256_set1_ps(keep), v_rest = _mm256_set1_ps(1 - keep);
+		const __m256 v_base = _mm256_set1_ps(base), v_weight0 = _mm256_set1_ps(weight0), v_weight1 = _mm256_set1_ps(weight1);
+		for (size_t i = 0; i != bytes; ++i) {
+			float* dat = alpha + (mirror ? bytes - 1 - i : i) * 8;
+			__m256i b = _mm256_set1_epi32(plane0[i]);
+			__m256 v = _mm256_add_ps(v_base, _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(b, bits), bits)), v_weight0));
+			if (plane1) {
+				b = _mm256_set1_epi32(plane1[i]);
+				v = _mm256_add_ps(v, _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(b, bits), bits)), v_weight1));
+			}
+			_mm256_storeu_ps(dat, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(dat), v_keep), _mm256_mul_ps(v, v_rest)));
+		}
+		// The caller is built for SSE, leaving the upper halves dirty makes every SSE instruction after it pay a transition.
+		_mm256_zeroupper();
+	}
+
+	LCD_TARGET_AVX2 static void DecayAVX2(float* alpha, const float* target, size_t count, float keep) {
+		const __m256 v_keep = _mm256_set1_ps(keep);
+		size_t i = 0;
+		if (!target) {
+			for (; i + 8 <= count; i += 8)
+				_mm256_storeu_ps(alpha + i, _mm256_mul_ps(_mm256_loadu_ps(alpha + i), v_keep));
+		}
+		else {
+			for (; i + 8 <= count; i += 8) {
+				__m256 t = _mm256_loadu_ps(target + i);
+				_mm256_storeu_ps(alpha + i, _mm256_add_ps(t, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(alpha + i), t), v_keep)));
+			}
+		}
+		_mm256_zeroupper();
+		DecayScalar(alpha + i, target ? target + i : nullptr, count - i, keep);
+	}
+
+	static bool HostHasSSE2() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return info[3] & (1 << 26);
+#else
+		return __builtin_cpu_supports("sse2");
+#endif
+	}
+
+	static bool HostHasAVX2() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		// AVX needs OS support for saving the YMM registers.
+		if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return info[1] & (1 << 5);
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+	static const LcdKernel kernel_scalar{"scalar", BlendRowScalar, DecayScalar};
+#ifdef LCD_KERNEL_X86
+	static const LcdKernel kernel_sse2{"sse2", BlendRowSSE2, DecaySSE2};
+	static const LcdKernel kernel_avx2{"avx2", BlendRowAVX2, DecayAVX2};
+#endif
+
+	static std::vector<const LcdKernel*> AvailableKernels() {
+		std::vector<const LcdKernel*> kernels{&kernel_scalar};
+#ifdef LCD_KERNEL_X86
+		if (HostHasSSE2())
+			kernels.push_back(&kernel_sse2);
+		if (HostHasAVX2())
+			kernels.push_back(&kernel_avx2);
+#endif
+		return kernels;
+	}
+
+	/**
+	 * A screenful of random dots, 64 rows of 24 bytes in two planes, the way Screen blends them.
+	 */
+	struct LcdWorkload {
+		static constexpr int rows = 64, row_bytes = 24, row_size = 32;
+		static constexpr float ink_alpha_on = 300, ink_alpha_off = 40, ratio = 1 - 5e-4f;
+		std::vector<uint8_t> plane0, plane1;
+
+		LcdWorkload() : plane0(rows * row_size), plane1(rows * row_size) {
+			std::mt19937 rng(0x0d000721);
+			for (auto& byte : plane0)
+				byte = (uint8_t)rng();
+			for (auto& byte : plane1)
+				byte = (uint8_t)rng();
+		}
+
+		/**
+		 * Runs `frames` frames of `kernel` into `alpha` and returns the seconds taken.
+		 */
+		double Run(const LcdKernel& kernel, int frames, std::vector<float>& alpha) const {
+			alpha.assign(rows * 192, 0);
+			auto start = std::chrono::steady_clock::now();
+			for (int frame = 0; frame != frames; ++frame)
+				for (int iy = 0; iy != rows; ++iy)
+					kernel.blend_row(&plane0[iy * row_size], &plane1[iy * row_size], row_bytes, ink_alpha_off,
+						(ink_alpha_on - ink_alpha_off) * 0.2f, (ink_alpha_on - ink_alpha_off) * 0.8f, false, &alpha[iy * 192], ratio);
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+	};
+
+	/**
+	 * Wider isn't always faster (AVX2 lost to SSE2 on some hosts), so the first call times every
+	 * available kernel for a few milliseconds and keeps the fastest.
+	 */
+	static const LcdKernel& SelectedKernel() {
+		static const LcdKernel& kernel = [] () -> const LcdKernel& {
+			LcdWorkload workload;
+			std::vector<float> alpha;
+			const LcdKernel* best = &kernel_scalar;
+			double best_time = INFINITY;
+			for (auto kernel : AvailableKernels()) {
+				double time = INFINITY;
+				for (int round = 0; round != 3; ++round)
+					time = std::min(time, workload.Run(*kernel, 16, alpha));
+				if (time < best_time) {
+					best = kernel;
+					best_time = time;
+				}
+			}
+			logger::Info("[LcdKernel][Info] Using %s, %.2f us/frame\n", best->name, best_time / 16 * 1e6);
+			return *best;
+		}();
+		return kernel;
+	}
+
+	void LcdBlendRow(const uint8_t* plane0, const uint8_t* plane1, size_t bytes, float base, float weight0, float weight1, bool mirror, float* alpha, float keep) {
+		SelectedKernel().blend_row(plane0, plane1, bytes, base, weight0, weight1, mirror, alpha, keep);
+	}
+
+	void LcdDecay(float* alpha, const float* target, size_t count, float keep) {
+		SelectedKernel().decay(alpha, target, count, keep);
+	}
+
+	const char* LcdKernelName() {
+		return SelectedKernel().name;
+	}
+
+	int LcdRunBenchmark() {
+		const int frames = 20000;
+		LcdWorkload workload;
+		const auto& plane0 = workload.plane0;
+		const auto& plane1 = workload.plane1;
+		const float ink_alpha_on = workload.ink_alpha_on, ink_alpha_off = workload.ink_alpha_off, ratio = workload.ratio;
+
+		// The per-dot loop Screen used before the kernels, kept inline as the reference.
+		std::vector<float> reference(workload.rows * 192);
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame != frames; ++frame) {
+			for (int iy = 0; iy != workload.rows; ++iy) {
+				int x = 0;
+				for (int ix = 0; ix != workload.row_bytes; ++ix) {
+					auto index = iy * workload.row_size + ix;
+					for (uint8_t mask = 0x80; mask; mask >>= 1) {
+						float ink_alpha = ink_alpha_off;
+						if (plane0[index] & mask)
+							ink_alpha += (ink_alpha_on - ink_alpha_off) * 0.2f;
+						if (plane1[index] & mask)
+							ink_alpha += (ink_alpha_on - ink_alpha_off) * 0.8f;
+						float& dat = reference[x + iy * 192];
+						dat = dat * ratio + ink_alpha * (1 - ratio);
+						x++;
+					}
+				}
+			}
+		}
+		double reference_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("[LcdKernel][Info] %d frames of %dx%d dots\n", frames, workload.row_bytes * 8, workload.rows);
+		printf("[LcdKernel][Info] %-8s %8.2f ns/frame\n", "baseline", reference_time / frames * 1e9);
+
+		int result = 0;
+		for (auto kernel : AvailableKernels()) {
+			std::vector<float> alpha;
+			double time = workload.Run(*kernel, frames, alpha);
+			float max_error = 0;
+			for (size_t i = 0; i != alpha.size(); ++i)
+				max_error = std::max(max_error, std::abs(alpha[i] - reference[i]));
+			printf("[LcdKernel][Info] %-8s %8.2f ns/frame, %5.2fx, max error %g\n", kernel->name, time / frames * 1e9, reference_time / time, max_error);
+			if (max_error > 0.5f) {
+				printf("[LcdKernel][Error] %s disagrees with the baseline\n", kernel->name);
+				result = 1;
+			}
+		}
+		printf("[LcdKernel][Info] Selected %s\n", LcdKernelName());
+		return result;
+	}
+} // namespace casioemu
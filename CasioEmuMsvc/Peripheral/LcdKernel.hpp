@@ -0,0 +1,35 @@
+﻿#pragma once
+#include "Config.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace casioemu {
+	/**
+	 * Bulk helpers for the LCD ink model in Screen. Every entry point dispatches to the fastest of
+	 * the AVX2, SSE2 and scalar implementations the host CPU supports, timed once on first use.
+	 */
+
+	/**
+	 * Moves `bytes * 8` alphas towards `base + weight0 * bit(plane0) + weight1 * bit(plane1)` of
+	 * `bytes` VRAM bytes (MSB is the leftmost dot), keeping `keep` of the old value. `plane1` may
+	 * be null. With `mirror` dot x goes to `alpha[bytes * 8 - 1 - x]`.
+	 */
+	void LcdBlendRow(const uint8_t* plane0, const uint8_t* plane1, size_t bytes, float base, float weight0, float weight1, bool mirror, float* alpha, float keep);
+
+	/**
+	 * Moves `count` alphas towards `target`, or towards zero if `target` is null, keeping `keep` of the old value.
+	 */
+	void LcdDecay(float* alpha, const float* target, size_t count, float keep);
+
+	/**
+	 * Name of the implementation picked for this host.
+	 */
+	const char* LcdKernelName();
+
+	/**
+	 * Times every available implementation against the old per-dot scalar loop and prints the
+	 * results. Run with the `lcd_benchmark` argument. Returns the process exit code.
+	 */
+	int LcdRunBenchmark();
+} // namespace casioemu
@@ -196,6 +196,12 @@ namespace casioemu {
 			output_callback = callback;
 		}
 		void UpdateInterrupt(int pi_tmp);
+		void SaveState(std::ostream& os) {
+			Binary::WriteAll(os, dat_data, dat_dir, dat_mode0, dat_mode1, dat_con, dat_exicon, dat_ie, dat_is, PortLevel, PortInput, PortInputExists, PortInputOld, TriggerWhenRise, TriggerWhenFall, SamplingMode);
+		}
+		void LoadState(std::istream& is) {
+			Binary::ReadAll(is, dat_data, dat_dir, dat_mode0, dat_mode1, dat_con, dat_exicon, dat_ie, dat_is, PortLevel, PortInput, PortInputExists, PortInputOld, TriggerWhenRise, TriggerWhenFall, SamplingMode);
+		}
 	};
 	class Ports : public Peripheral, IPortProvider {
 	public:
@@ -244,6 +250,18 @@ namespace casioemu {
 			}
 			return 0;
 		}
+		void SaveState(std::ostream& os) override {
+			for (auto port : ports)
+				if (port)
+					port->SaveState(os);
+			Binary::WriteAll(os, ExiSelect_d, ExiCon_d);
+		}
+		void LoadState(std::istream& is) override {
+			for (auto port : ports)
+				if (port)
+					port->LoadState(is);
+			Binary::ReadAll(is, ExiSelect_d, ExiCon_d);
+		}
 		void* QueryInterface(const char* name) override {
 			if (strcmp(name, typeid(IPortProvider).name()) == 0) {
 				return (IPortProvider*)this;
@@ -0,0 +1,13 @@
+﻿#include "Peripheral.hpp"
+
+#include "Chipset/Chipset.hpp"
+#include "Emulator.hpp"
+
+namespace casioemu {
+	void Peripheral::SetClockType(int type) {
+		if (clock_type == type)
+			return;
+		clock_type = type;
+		emulator.chipset.InvalidateClockDomains();
+	}
+} // namespace casioemu
@@ -3,6 +3,8 @@
 
 #include <SDL.h>
 #include <any>
+#include <istream>
+#include <ostream>
 
 namespace casioemu {
 	class Emulator;
@@ -27,6 +29,11 @@ namespace casioemu {
 		int clock_type = CLOCK_SYSCLK;
 		int block_bit = -1;
 		Peripheral(Emulator& emulator) : emulator(emulator) {}
+		/**
+		 * Changes the clock that drives `Tick`. Always use this instead of assigning `clock_type`,
+		 * the chipset keeps per-clock peripheral lists that need to be told about the change.
+		 */
+		void SetClockType(int type);
 		virtual void Initialise() {}
 		virtual void Uninitialise() {}
 		virtual void Tick() {}
@@ -36,6 +43,14 @@ namespace casioemu {
 		virtual void Reset() {}
 		virtual void ResetLSCLK() {}
 		virtual void* QueryInterface(const char*) { return 0; }
+		/**
+		 * Machine state hooks, see Chipset::SaveState. SaveState writes with Binary whatever
+		 * LoadState needs to put the peripheral back exactly as it was: SFRs, counters, buffers.
+		 * Regions, host resources and view state are not part of it. LoadState runs on a
+		 * peripheral that is already initialised, after BLKCON has been restored.
+		 */
+		virtual void SaveState(std::ostream& os) {}
+		virtual void LoadState(std::istream& is) {}
 		virtual ~Peripheral() {}
 	};
 } // namespace casioemu
@@ -43,9 +43,11 @@ namespace casioemu {
 		void Initialise();
 		void Tick();
 		void Reset();
+		void SaveState(std::ostream& os) override;
+		void LoadState(std::istream& is) override;
 	};
 	void PowerSupply::Initialise() {
-		clock_type = CLOCK_UNDEFINED;
+		SetClockType(CLOCK_UNDEFINED);
 
 		BLDMode = 0;
 		BLDControl = 0;
@@ -183,6 +185,14 @@ namespace casioemu {
 		isTestRoutineRunning = false;
 		BLDFlag = emulator.BatteryVoltage >= ThreshVoltage[0] ? 1 : 0;
 	}
+
+	void PowerSupply::SaveState(std::ostream& os) {
+		Binary::WriteAll(os, threshold, data_BLDCON2, data_SPIndicator, BLDMode, BLDFlag, BLDControl, isTestRoutineRunning, TestTimer, CurrentTestMode, CurrentRepMode, HasResult, CurrentThresh, DelayTicks);
+	}
+
+	void PowerSupply::LoadState(std::istream& is) {
+		Binary::ReadAll(is, threshold, data_BLDCON2, data_SPIndicator, BLDMode, BLDFlag, BLDControl, isTestRoutineRunning, TestTimer, CurrentTestMode, CurrentRepMode, HasResult, CurrentThresh, DelayTicks);
+	}
 	Peripheral* CreatePowerSupply(Emulator& emu) {
 		return new PowerSupply(emu);
 	}
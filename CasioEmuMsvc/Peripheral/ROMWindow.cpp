@@ -6,6 +6,7 @@
 #include "Logger.hpp"
 #include "ModelInfo.h"
 
+#include <cstdint>
 #include <string>
 
 namespace casioemu {
@@ -18,8 +19,9 @@ namespace casioemu {
 		void Initialise();
 	};
 	static void SetupROMRegion(MMURegion& region, size_t region_base, size_t size, size_t rom_base, bool strict_memory, Emulator& emulator, std::string description = {}) {
-		uint8_t* data = emulator.chipset.rom_data.data();
-		auto offset = (long long)rom_base - (long long)region_base;
+		// The image can be detached from the shared copy later on (see RomImage::MakeWritable),
+		// so reads go through rom_data each time, userdata only holds the window's offset.
+		auto offset = (intptr_t)rom_base - (intptr_t)region_base;
 		if (description.empty())
 			description = "ROM/Segment" + std::to_string(region_base >> 16);
 
@@ -31,18 +33,27 @@ namespace casioemu {
 																	  // printf("ROM::[region write lambda]: attempt to write %02hhX to %06zX\n", data, address);
 																  };
 
-		if (offset >= 0)
-			region.Setup(
-				region_base, size, description, data + offset, [](MMURegion* region, size_t address) {
-					return ((uint8_t*)(region->userdata))[address];
-				},
-				write_function, emulator);
-		else
-			region.Setup(
-				region_base, size, description, data + rom_base, [](MMURegion* region, size_t address) {
-					return ((uint8_t*)(region->userdata))[address - region->base];
-				},
-				write_function, emulator);
+		region.Setup(
+			region_base, size, description, (void*)offset, [](MMURegion* region, size_t address) {
+				return region->emulator->chipset.rom_data[address + (intptr_t)region->userdata];
+			},
+			write_function, emulator);
+	}
+
+	size_t GetRomWindowSize(int hardware_id) {
+		switch (hardware_id) {
+		case HW_ES_PLUS:
+		case HW_FX_5800P:
+			return 0x20000;
+		case HW_CLASSWIZ:
+			return 0x40000;
+		case HW_TI:
+		case HW_CLASSWIZ_II:
+			return 0x60000;
+		default:
+			PANIC("Unknown Model type");
+			return 0;
+		}
 	}
 
 	void ROMWindow::Initialise() {
@@ -51,7 +62,6 @@ namespace casioemu {
 		switch (emulator.hardware_id) { // Initializer list cannot be used with move-only type: https://stackoverflow.com/q/8468774
 		case HW_ES_PLUS:
 			regions.reset(new MMURegion[3]);
-			emulator.chipset.rom_data.resize(0x20000, 0);
 			SetupROMRegion(regions[0], 0x00000, 0x08000, 0x00000, strict_memory, emulator);
 			SetupROMRegion(regions[1], 0x10000, 0x10000, 0x10000, strict_memory, emulator);
 			SetupROMRegion(regions[2], 0x80000, 0x10000, 0x00000, strict_memory, emulator);
@@ -59,7 +69,6 @@ namespace casioemu {
 
 		case HW_CLASSWIZ:
 			regions.reset(new MMURegion[5]);
-			emulator.chipset.rom_data.resize(0x40000, 0);
 			SetupROMRegion(regions[0], 0x00000, 0x0D000, 0x00000, strict_memory, emulator);
 			SetupROMRegion(regions[1], 0x10000, 0x10000, 0x10000, strict_memory, emulator);
 			SetupROMRegion(regions[2], 0x20000, 0x10000, 0x20000, strict_memory, emulator);
@@ -70,7 +79,6 @@ namespace casioemu {
 		case HW_TI:
 		case HW_CLASSWIZ_II:
 			regions.reset(new MMURegion[16]);
-			emulator.chipset.rom_data.resize(0x60000, 0);
 			SetupROMRegion(regions[0], 0x00000, 0x09000, 0x00000, strict_memory, emulator);
 			SetupROMRegion(regions[1], 0x10000, 0x10000, 0x10000, strict_memory, emulator);
 			SetupROMRegion(regions[2], 0x20000, 0x10000, 0x20000, strict_memory, emulator);
@@ -100,7 +108,6 @@ namespace casioemu {
 			break;
 		case HW_FX_5800P:
 			regions.reset(new MMURegion[2]);
-			emulator.chipset.rom_data.resize(0x20000, 0);
 			SetupROMRegion(regions[0], 0x00000, 0x8000, 0x00000, strict_memory, emulator);
 			SetupROMRegion(regions[1], 0x10000, 0x10000, 0x10000, strict_memory, emulator);
 			break;
@@ -1,4 +1,9 @@
 ﻿#pragma once
+#include <cstddef>
 namespace casioemu {
 	class Peripheral* CreateRomWindow(class Emulator& emu);
+	/**
+	 * Size the ROM image is padded (or cut) to so that every window of the model maps into it.
+	 */
+	size_t GetRomWindowSize(int hardware_id);
 }
\ No newline at end of file
@@ -49,9 +49,11 @@ namespace casioemu {
 		void Initialise();
 		void Reset();
 		void Tick();
+		void SaveState(std::ostream& os) override;
+		void LoadState(std::istream& is) override;
 	};
 	void RealTimeClock::Initialise() {
-		clock_type = CLOCK_LSCLK;
+		SetClockType(CLOCK_LSCLK);
 
 		RTCSEC = RTCMIN = RTCDAY = RTCMON = RTCYEAR = RTCCON = AL0MIN = AL0HOUR = AL0WEEK = AL1MIN = AL1HOUR = AL1DAY = AL1MON = 0;
 		RTCWEEK = 1;
@@ -240,6 +242,14 @@ namespace casioemu {
 	void RealTimeClock::Reset() {
 		RTCCON = 0;
 	}
+
+	void RealTimeClock::SaveState(std::ostream& os) {
+		Binary::WriteAll(os, RTCSEC, RTCMIN, RTCHOUR, RTCWEEK, RTCDAY, RTCMON, RTCYEAR, RTCCON, AL0MIN, AL0HOUR, AL0WEEK, AL1MIN, AL1HOUR, AL1DAY, AL1MON, RTCSEC_carry);
+	}
+
+	void RealTimeClock::LoadState(std::istream& is) {
+		Binary::ReadAll(is, RTCSEC, RTCMIN, RTCHOUR, RTCWEEK, RTCDAY, RTCMON, RTCYEAR, RTCCON, AL0MIN, AL0HOUR, AL0WEEK, AL1MIN, AL1HOUR, AL1DAY, AL1MON, RTCSEC_carry);
+	}
 	Peripheral* CreateRtc(Emulator& emu) {
 		return new RealTimeClock(emu);
 	}
@@ -18,20 +18,26 @@
 
 */
 #include "Screen.hpp"
+#include "BatteryBackedRAM.hpp"
 #include "Chipset/Chipset.hpp"
 #include "Chipset/MMU.hpp"
 #include "Chipset/MMURegion.hpp"
 #include "Emulator.hpp"
+#include "FrameRecorder.hpp"
+#include "Gui/Hooks.h"
 #include "Gui/HwController.h"
+#include "LcdKernel.hpp"
 #include "Logger.hpp"
 #include "ML620Ports.h"
 #include "ModelInfo.h"
 #include "Models.h"
-#include "Ui.hpp"
+#include "TripleBuffer.h"
 #include <algorithm> // for std::generate
 #include <array>
-#include <cstdlib> // for std::rand
+#include <cstdlib>
+#include <cstring>
 #include <ctime>   // for std::time
+#include <random> // for std::minstd_rand
 #include <vector>
 
 inline constexpr uint8_t reverse_bits(uint8_t n) {
@@ -54,10 +60,11 @@ inline constexpr std::array<uint8_t, 256> generate_lookup_table() {
 // 定义查找表
 constexpr auto bit_lookup_table = generate_lookup_table();
 
-inline void fillRandomData(unsigned char* buf, size_t size) {
-	std::srand(static_cast<unsigned int>(SDL_GetPerformanceCounter())); // 使用当前时间作为随机种子
-	std::generate(buf, buf + size, []() {
-		return static_cast<unsigned char>(std::rand() % 256); // 生成0到255之间的随机数
+inline void fillRandomData(unsigned char* buf, size_t size, unsigned int seed) {
+	// A generator of its own, std::rand is shared by every emulator in the process. See Emulator::NextRandomSeed.
+	std::minstd_rand rng(seed);
+	std::generate(buf, buf + size, [&]() {
+		return static_cast<unsigned char>(rng() % 256); // 生成0到255之间的随机数
 	});
 }
 
@@ -82,7 +89,7 @@ namespace casioemu {
 		}
 	}
 	template <HardwareId hardware_id>
-	class Screen : public Peripheral {
+	class Screen : public Peripheral, public IFramebuffer {
 		static int const N_ROW,
 			ROW_SIZE,
 			OFFSET,
@@ -112,11 +119,20 @@ namespace casioemu {
 		int ti_port7{};
 		int ti_port5{};
 
-		float screen_scan_alpha[64]{};
 		float position = 0;
+		/**
+		 * This instance's BatteryBackedRAM buffer, looked up on first use since the RAM may be set
+		 * up after the screen.
+		 */
+		uint8_t* ram{};
+		uint8_t* GetRam() {
+			if (!ram)
+				if (auto iram = emulator.chipset.QueryInterface<IRam>())
+					ram = (uint8_t*)iram->GetRam();
+			return ram;
+		}
 		SDL_Renderer* renderer{};
 		SDL_Texture* interface_texture{};
-		float screen_ink_alpha[66 * 192]{};
 		static const SpriteBitmap sprite_bitmap[];
 		std::vector<SpriteInfo> sprite_info;
 		ColourInfo ink_colour{};
@@ -124,17 +140,126 @@ namespace casioemu {
 		bool inited = 0;
 		bool enabled_2 = 0;
 
+		/**
+		 * What a viewer of the LCD has seen so far: the faded ink level of every dot (status row
+		 * first) and the composited dot matrix. The window and the recorder each keep their own.
+		 */
+		struct LcdView {
+			float ink_alpha[66 * 192]{};
+			float scan_alpha[64]{};
+			double last_decay_time = 0;
+			std::vector<Uint32> pixels;
+		};
+		LcdView view;
+
+		/**
+		 * The dot matrix is composited on the CPU into `LcdView::pixels` (ARGB8888, one rsd_pixel cell
+		 * per dot) and drawn with a single copy of `lcd_texture`, instead of one render copy per dot.
+		 * `pixel_sprite` holds the rsd_pixel texels taken from the interface image.
+		 */
+		SDL_Texture* lcd_texture{};
+		std::vector<Uint32> pixel_sprite;
+		int lcd_width{}, lcd_height{};
+		void CompositeLCD(LcdView& v);
+		/**
+		 * Where the dot matrix goes on the interface, each dot scaled to the rsd_pixel dest size.
+		 */
+		SDL_Rect LcdDest() const {
+			auto& pixel = sprite_info[0].dest;
+			return {pixel.x, pixel.y, ROW_SIZE_DISP * 8 * pixel.w, N_ROW * pixel.h};
+		}
+
+		/**
+		 * Everything the renderer needs from the LCD. The emulation thread captures it every
+		 * `1 / publish_rate` emulated second in `Tick` and hands it over through `published`, so
+		 * Frame never touches the live registers or VRAM and always draws one consistent frame.
+		 */
+		struct LcdState {
+			uint8_t plane0[0x800], plane1[0x800];
+			size_t row_size;
+			uint8_t mode, range, contrast, brightness, contrast2, contrast2_en, select, offset, refresh_rate, power;
+			bool enabled, ti_enabled;
+			int ti_contrast, buffer_select;
+			uint64_t vram_serial;
+			double time;
+		};
+		static constexpr int publish_rate = 64;
+		TripleBuffer<LcdState> published;
+		uint64_t next_publish_tick = 0;
+		void CaptureState(LcdState& state);
+		void PublishState();
+
+		/**
+		 * Frame export, see FrameRecorder. Runs on the emulation thread every `1 / record_fps`
+		 * emulated second with its own view, so it needs no window and isn't tied to the host clock.
+		 * `record_interface` is the converted interface image when the calculator body is included.
+		 */
+		FrameRecorder* recorder{};
+		int record_fps{};
+		uint64_t next_record_tick = 0;
+		LcdState record_state{};
+		LcdView record_view;
+		SDL_Surface *record_frame{}, *record_interface{};
+		void RecordFrame();
+
+		/**
+		 * View behind IFramebuffer, brought up to date on every read. Sized on first use.
+		 */
+		LcdState framebuffer_state{};
+		LcdView framebuffer_view;
+
+		/**
+		 * `on_screen_changed` is raised for every published state up to `settle_until`, the
+		 * emulated time at which the fading after the last change has settled, so that an on
+		 * demand renderer keeps drawing until then.
+		 */
+		uint64_t published_serial = 0;
+		std::array<int, 16> published_signature{};
+		double settle_until = 0;
+
+		/**
+		 * Change tracking so static frames skip the decay, composition and upload. On the emulation
+		 * side, VRAM writes are seen through the MMU page stamps (`vram_stamp`) and the buffer changes
+		 * the screen makes itself set `vram_dirty`; either bumps the published `vram_serial`. Frame
+		 * compares that and a `StateSignature` of the rest. After a change it keeps updating until
+		 * the ink decay has settled.
+		 */
+		uint64_t vram_stamp = 0, vram_serial = 0;
+		bool vram_dirty = true;
+		uint64_t shown_vram_serial = ~(uint64_t)0;
+		std::array<int, 16> last_signature{};
+		float settle_residual = 1;
+		uint64_t VRAMStamp();
+		std::array<int, 16> StateSignature(const LcdState& state);
+		bool NeedsUpdate(const LcdState& state);
+
+		/**
+		 * Ink persistence is a first-order low-pass towards the current VRAM contents. It advances
+		 * `decay_steps_per_second` steps per emulated second, each step keeping `decay_ratio()` of
+		 * the previous alpha, and is caught up in one go when a view is updated.
+		 */
+		static constexpr double decay_steps_per_second = 32768;
+		float Advance(LcdView& v, const LcdState& state);
+
+		static constexpr float decay_ratio() {
+			if constexpr (hardware_id == HW_ES_PLUS || hardware_id == HW_TI)
+				return 1 - 1e-4;
+			else
+				return 1 - 5e-4;
+		}
+
 	public:
 		Screen(Emulator& emu)
 			: Peripheral(emu) {
-			std::thread thd([&]() {
-				while (1) {
-					tick();
-				}
-			});
-			thd.detach();
 		}
 		~Screen() {
+			delete recorder;
+			if (record_frame)
+				SDL_FreeSurface(record_frame);
+			if (record_interface)
+				SDL_FreeSurface(record_interface);
+			if (lcd_texture)
+				SDL_DestroyTexture(lcd_texture);
 			if (screen_buffer)
 				delete[] screen_buffer;
 			if (screen_buffer1)
@@ -142,33 +267,45 @@ namespace casioemu {
 		}
 		void Initialise() override;
 		void Uninitialise() override;
+		void SaveState(std::ostream& os) override;
+		void LoadState(std::istream& is) override;
+		void Tick() override {
+			auto now = emulator.chipset.ticks_elapsed;
+			if (recorder && now >= next_record_tick) {
+				next_record_tick += emulator.GetCyclesPerSecond() / record_fps;
+				RecordFrame();
+			}
+			// Without a window nobody acquires the published state, IFramebuffer reads on demand.
+			if (emulator.headless || now < next_publish_tick)
+				return;
+			next_publish_tick = now + emulator.GetCyclesPerSecond() / publish_rate;
+			PublishState();
+		}
 		void Frame() override;
 		void Reset() override;
+		void ReadFramebuffer(std::vector<uint32_t>& pixels, int& width, int& height) override;
+		void* QueryInterface(const char* name) override {
+			if (strcmp(name, typeid(IFramebuffer).name()) == 0) {
+				return (IFramebuffer*)this;
+			}
+			return 0;
+		}
 
-		void tick() {
-			float ratio = 0;
-			if constexpr (hardware_id == HW_ES_PLUS)
-				ratio = 1 - 1e-4;
-			else
-				ratio = 1 - 5e-4;
-
+		/**
+		 * Moves the ink levels of `v` towards the VRAM contents in `s`, keeping `ratio` of the old value.
+		 */
+		void tick(LcdView& v, const LcdState& s, float ratio) {
 			if constexpr (hardware_id == HW_TI) {
-				ratio = 1 - 1e-4;
-				if (!ti_enabled) {
-					for (size_t i = 0; i < 65 * 192; i++) {
-						screen_ink_alpha[i] *= ratio;
-					}
+				if (!s.ti_enabled) {
+					LcdDecay(v.ink_alpha, nullptr, 65 * 192, ratio);
 					return;
 				}
-				if (!n_ram_buffer) //  || !emulator.chipset.ti_status_buf) //  || !emulator.chipset.ti_screen_buf
-					return;
-				float ink_alpha_on = (ti_contrast - 100) * 20.0;
+				float ink_alpha_on = (s.ti_contrast - 100) * 20.0;
 				float ink_alpha_off = std::clamp(ink_alpha_on * 0.1, 0.0, 255.0);
 				ink_alpha_on = std::clamp(ink_alpha_on, 0.0f, 255.0f);
-				uint8_t* screen_buffer = (uint8_t*)n_ram_buffer - casioemu::GetRamBaseAddr(hardware_id) + 0xE708;
-				if (emulator.modeldef.real_hardware) {
-					screen_buffer = this->screen_buffer;
-				}
+				const uint8_t* screen_buffer = s.plane0;
+				// The ST7525 buffer is column major, so only the blend is done in bulk.
+				float target[64 * 192];
 				for (int ix = 0; ix < 192; ++ix) {
 					for (int iy = 0; iy < 64; ++iy) {
 						uint32_t i = (ix << 6) | iy;
@@ -176,18 +313,15 @@ namespace casioemu {
 						int subIndx = (i & 7);
 						int mask = (1 << subIndx);
 						bool on = (screen_buffer[bIndx] & mask) != 0;
-						auto& data = screen_ink_alpha[(iy * 192 + 192) + ix];
-						data = data * ratio + (on ? ink_alpha_on : ink_alpha_off) * (1 - ratio);
+						target[iy * 192 + ix] = on ? ink_alpha_on : ink_alpha_off;
 					}
 				}
-				screen_buffer = (uint8_t*)n_ram_buffer - casioemu::GetRamBaseAddr(hardware_id) + 0xe5d4;
-				if (emulator.modeldef.real_hardware) {
-					screen_buffer = this->screen_buffer + 8 * 192;
-				}
+				LcdDecay(v.ink_alpha + 192, target, 64 * 192, ratio);
+				screen_buffer = s.plane0 + 8 * 192;
 				int x = 0;
 				for (int ix = 1; ix != SPR_MAX; ++ix) {
 					auto off = sprite_bitmap[ix].offset;
-					auto& data = screen_ink_alpha[x];
+					auto& data = v.ink_alpha[x];
 					data = data * ratio + ((screen_buffer[off] & sprite_bitmap[ix].mask) ? ink_alpha_on : ink_alpha_off) * (1 - ratio);
 					x++;
 				}
@@ -195,21 +329,19 @@ namespace casioemu {
 				return;
 			}
 
+			int screen_refresh_rate = std::max<int>(s.refresh_rate, 6);
 			if (screen_refresh_rate < screen_flashing_threshold && !enable_screen_fading)
 				;
 			else {
-				update_screen_scan_alpha(screen_scan_alpha, SDL_GetTicks64(), screen_refresh_rate);
+				update_screen_scan_alpha(v.scan_alpha, v.last_decay_time * 1000, screen_refresh_rate);
 			}
-			if (screen_refresh_rate < 6) {
-				screen_refresh_rate = 6;
-			}
-			auto sb = screen_brightness;
+			auto sb = s.brightness;
 			if (sb < 3) {
 				sb = 3;
 			}
-			auto contrast = (int)screen_contrast - 11;
-			if (screen_contrast2_en) {
-				contrast += screen_contrast2 * 0.5;
+			auto contrast = (int)s.contrast - 11;
+			if (s.contrast2_en) {
+				contrast += s.contrast2 * 0.5;
 			}
 			if (contrast < 0) {
 				contrast = 0;
@@ -230,24 +362,14 @@ namespace casioemu {
 
 			bool mode_6 = false;
 
-			auto screen_buffer = this->screen_buffer;
-			uint8_t* screen_buffer1;
-			size_t row_size = ROW_SIZE;
-			if constexpr (hardware_id == HW_CLASSWIZ_II) {
-				screen_buffer1 = this->screen_buffer1;
-			}
-			if (screen_buffer_select != 0) {
-				screen_buffer = (uint8_t*)n_ram_buffer - casioemu::GetRamBaseAddr(hardware_id) + casioemu::GetScreenBufferOffset(emulator.hardware_id, screen_buffer_select);
-				if (hardware_id == HW_CLASSWIZ_II) {
-					screen_buffer1 = screen_buffer + 0x600;
-				}
-				row_size = ROW_SIZE_DISP;
-			}
+			const uint8_t* screen_buffer = s.plane0;
+			const uint8_t* screen_buffer1 = s.plane1;
+			size_t row_size = s.row_size;
 
-			if (!enabled_2)
+			if (!s.enabled)
 				goto clean_scr;
 
-			switch (screen_mode & 7) {
+			switch (s.mode & 7) {
 			case 4: // 100
 				enable_dotmatrix = true;
 				clear_dots = true;
@@ -270,17 +392,17 @@ namespace casioemu {
 			default:
 				goto clean_scr;
 			}
-			if (screen_range & 0b100000)
+			if (s.range & 0b100000)
 				goto clean_scr;
 			{
-				bool flip_screen_h = screen_mode & 0b1000;
-				bool flip_screen_v = !(screen_mode & 0b10000);
+				bool flip_screen_h = s.mode & 0b1000;
+				bool flip_screen_v = !(s.mode & 0b10000);
 				if constexpr (hardware_id == HW_CLASSWIZ || hardware_id == HW_CLASSWIZ_II) {
 				}
 				else {
 					flip_screen_v = flip_screen_v = 0;
 				}
-				int rng1 = (4 - (screen_range & 0x3));
+				int rng1 = (4 - (s.range & 0x3));
 				ink_alpha_off *= (4 / rng1);
 				ink_alpha_on *= (4 / rng1);
 				int rng = rng1 * 8;
@@ -291,149 +413,78 @@ namespace casioemu {
 						int x = 0;
 						for (int ix = 1; ix != SPR_MAX; ++ix) {
 							ink_alpha = ink_alpha_off;
-							auto off = (sprite_bitmap[ix].offset + screen_offset * row_size) % ((N_ROW + 1) * row_size);
+							auto off = (sprite_bitmap[ix].offset + s.offset * row_size) % ((N_ROW + 1) * row_size);
 							if (screen_buffer[off] & sprite_bitmap[ix].mask)
 								ink_alpha += (ink_alpha_on - ink_alpha_off) * 0.2;
 							if (screen_buffer1[off] & sprite_bitmap[ix].mask)
 								ink_alpha += (ink_alpha_on - ink_alpha_off) * 0.8;
 							if (screen_refresh_rate >= screen_flashing_threshold)
-								ink_alpha *= screen_scan_alpha[0];
-							screen_ink_alpha[x] = screen_ink_alpha[x] * ratio + ink_alpha * (1 - ratio);
+								ink_alpha *= v.scan_alpha[0];
+							v.ink_alpha[x] = v.ink_alpha[x] * ratio + ink_alpha * (1 - ratio);
 							x++;
 						}
 					}
 					else {
 						int x = 0;
 						for (int ix = 1; ix != SPR_MAX; ++ix) {
-							auto off = (sprite_bitmap[ix].offset + screen_offset * row_size) % ((N_ROW + 1) * row_size);
+							auto off = (sprite_bitmap[ix].offset + s.offset * row_size) % ((N_ROW + 1) * row_size);
 							if (screen_buffer[off] & sprite_bitmap[ix].mask)
 								ink_alpha = ink_alpha_on;
 							else
 								ink_alpha = ink_alpha_off;
 							if (screen_refresh_rate >= screen_flashing_threshold)
-								ink_alpha *= screen_scan_alpha[0];
-							screen_ink_alpha[x] = screen_ink_alpha[x] * ratio + ink_alpha * (1 - ratio);
+								ink_alpha *= v.scan_alpha[0];
+							v.ink_alpha[x] = v.ink_alpha[x] * ratio + ink_alpha * (1 - ratio);
 							x++;
 						}
 					}
 				}
 				else {
-					if constexpr (hardware_id == HW_CLASSWIZ_II) {
-						for (size_t i = 0; i < 192; i++) {
-							screen_ink_alpha[i] *= ratio;
-						}
-					}
-					else {
-						for (size_t i = 0; i < 192; i++) {
-							screen_ink_alpha[i] *= ratio;
-						}
-					}
+					LcdDecay(v.ink_alpha, nullptr, 192, ratio);
 				}
 
 				if (enable_dotmatrix) {
-					static constexpr auto SPR_PIXEL = 0;
-					SDL_Rect dest = Screen<hardware_id>::sprite_info[SPR_PIXEL].dest;
-					int ink_alpha = ink_alpha_off;
 					if (mode_6) {
 						ink_alpha_on = ink_alpha_off /= 2.55;
 					}
-					if constexpr (hardware_id == HW_CLASSWIZ_II) {
-						for (int iy2 = 1; iy2 != (N_ROW + 1); ++iy2) {
-							int iy = (iy2 + screen_offset) % (N_ROW + 1);
-							bool clear = 0;
-							if (iy2 >= rng && iy2 < 32)
-								clear = 1;
-							if (iy2 >= 32) {
-								if (iy2 <= 32 + rng) {
-									iy = (iy2 - 32 + rng + screen_offset) % (N_ROW + 1);
-								}
-								else {
-									clear = 1;
-								}
+					for (int iy2 = 1; iy2 != (N_ROW + 1); ++iy2) {
+						int iy = (iy2 + s.offset) % (N_ROW + 1);
+						bool clear = 0;
+						if (iy2 >= rng && iy2 < 32)
+							clear = 1;
+						if (iy2 >= 32) {
+							if (iy2 <= 32 + rng) {
+								iy = (iy2 - 32 + rng + s.offset) % (N_ROW + 1);
 							}
-							dest.x = sprite_info[SPR_PIXEL].dest.x;
-							dest.y = sprite_info[SPR_PIXEL].dest.y + (iy2 - 1) * sprite_info[SPR_PIXEL].src.h;
-							int x = 0;
-							for (int ix = 0; ix != ROW_SIZE_DISP; ++ix) {
-								auto index = (flip_screen_v ? N_ROW - iy : iy) * row_size + ix;
-								for (uint8_t mask = 0x80; mask; mask >>= 1, dest.x += sprite_info[SPR_PIXEL].src.w) {
-									ink_alpha = ink_alpha_off;
-									if (!clear_dots && screen_buffer[index] & mask)
-										ink_alpha += (ink_alpha_on - ink_alpha_off) * 0.2;
-									if (!clear_dots && screen_buffer1[index] & mask)
-										ink_alpha += (ink_alpha_on - ink_alpha_off) * 0.8;
-									if (screen_refresh_rate >= screen_flashing_threshold)
-										ink_alpha *= screen_scan_alpha[iy];
-									if (clear)
-										ink_alpha = 0;
-									float& dat = screen_ink_alpha[(flip_screen_h ? (191 - x) : x) + iy2 * 192];
-									dat = dat * ratio + ink_alpha * (1 - ratio);
-									x++;
-								}
-							}
-						}
-					}
-					else {
-						for (int iy2 = 1; iy2 != (N_ROW + 1); ++iy2) {
-							int iy = (iy2 + screen_offset) % (N_ROW + 1);
-							bool clear = 0;
-							if (iy2 >= rng && iy2 < 32)
+							else {
 								clear = 1;
-							if (iy2 >= 32) {
-								if (iy2 <= 32 + rng) {
-									iy = (iy2 - 32 + rng + screen_offset) % (N_ROW + 1);
-								}
-								else {
-									clear = 1;
-								}
-							}
-							dest.x = sprite_info[SPR_PIXEL].dest.x;
-							dest.y = sprite_info[SPR_PIXEL].dest.y + (iy2 - 1) * sprite_info[SPR_PIXEL].src.h;
-							int x = 0;
-							for (int ix = 0; ix != ROW_SIZE_DISP; ++ix) {
-								auto index = (flip_screen_v ? N_ROW + 1 - iy : iy) * row_size + ix;
-								for (uint8_t mask = 0x80; mask; mask >>= 1, dest.x += sprite_info[SPR_PIXEL].src.w) {
-									if (screen_buffer[index] & mask)
-										ink_alpha = ink_alpha_on;
-									else
-										ink_alpha = ink_alpha_off;
-									if (screen_refresh_rate >= screen_flashing_threshold)
-										ink_alpha *= screen_scan_alpha[iy];
-									if (clear)
-										ink_alpha = 0;
-									float& dat = screen_ink_alpha[(flip_screen_h ? (191 - x) : x) + iy2 * 192];
-									dat = dat * ratio + ink_alpha * (1 - ratio);
-									x++;
-								}
 							}
 						}
-					}
-				}
-				else {
-					if constexpr (hardware_id == HW_CLASSWIZ_II) {
-						for (size_t i = 192; i < 64 * 192; i++) {
-							screen_ink_alpha[i] *= ratio;
+						float scale = screen_refresh_rate >= screen_flashing_threshold ? v.scan_alpha[iy] : 1;
+						if (clear)
+							scale = 0;
+						float swing = (ink_alpha_on - ink_alpha_off) * scale;
+						// A flipped row lands at the right end of the 192 dot line, as dot x goes to 191 - x.
+						float* alpha = v.ink_alpha + iy2 * 192 + (flip_screen_h ? 192 - ROW_SIZE_DISP * 8 : 0);
+						if constexpr (hardware_id == HW_CLASSWIZ_II) {
+							auto index = (flip_screen_v ? N_ROW - iy : iy) * row_size;
+							if (clear_dots)
+								swing = 0;
+							LcdBlendRow(screen_buffer + index, screen_buffer1 + index, ROW_SIZE_DISP, ink_alpha_off * scale, swing * 0.2f, swing * 0.8f, flip_screen_h, alpha, ratio);
 						}
-					}
-					else {
-						for (size_t i = 192; i < 64 * 192; i++) {
-							screen_ink_alpha[i] *= ratio;
+						else {
+							auto index = (flip_screen_v ? N_ROW + 1 - iy : iy) * row_size;
+							LcdBlendRow(screen_buffer + index, nullptr, ROW_SIZE_DISP, ink_alpha_off * scale, swing, 0, flip_screen_h, alpha, ratio);
 						}
 					}
 				}
+				else {
+					LcdDecay(v.ink_alpha + 192, nullptr, 63 * 192, ratio);
+				}
 			}
 			return;
 		clean_scr:
-			if constexpr (hardware_id == HW_CLASSWIZ_II) {
-				for (size_t i = 0; i < 64 * 192; i++) {
-					screen_ink_alpha[i] *= ratio;
-				}
-			}
-			else {
-				for (size_t i = 0; i < 64 * 192; i++) {
-					screen_ink_alpha[i] *= ratio;
-				}
-			}
+			LcdDecay(v.ink_alpha, nullptr, 64 * 192, ratio);
 			return;
 		}
 	};
@@ -570,6 +621,7 @@ namespace casioemu {
 	template <HardwareId hardware_id>
 	void Screen<hardware_id>::Initialise() {
 		if (!inited) {
+			SetClockType(CLOCK_UNDEFINED);
 			renderer = emulator.GetRenderer();
 			interface_texture = emulator.GetInterfaceTexture();
 			sprite_info.resize(SPR_MAX);
@@ -577,6 +629,35 @@ namespace casioemu {
 				sprite_info[ix] = emulator.modeldef.sprites[sprite_bitmap[ix].name];
 
 			ink_colour = emulator.modeldef.ink_color;
+
+			auto& pixel = sprite_info[0].src;
+			SDL_Surface* interface_argb = SDL_ConvertSurfaceFormat(emulator.interface_surface, SDL_PIXELFORMAT_ARGB8888, 0);
+			if (!interface_argb)
+				PANIC("SDL_ConvertSurfaceFormat failed: %s\n", SDL_GetError());
+			pixel_sprite.resize(pixel.w * pixel.h);
+			for (int sy = 0; sy != pixel.h; ++sy)
+				for (int sx = 0; sx != pixel.w; ++sx)
+					pixel_sprite[sy * pixel.w + sx] = ((Uint32*)((Uint8*)interface_argb->pixels + (pixel.y + sy) * interface_argb->pitch))[pixel.x + sx];
+			lcd_width = ROW_SIZE_DISP * 8 * pixel.w;
+			lcd_height = N_ROW * pixel.h;
+			if (!emulator.headless)
+				view.pixels.resize(lcd_width * lcd_height);
+			bool with_interface = emulator.argv_map.find("record_interface") != emulator.argv_map.end();
+			int frame_width = with_interface ? emulator.interface_background.dest.w : lcd_width;
+			int frame_height = with_interface ? emulator.interface_background.dest.h : lcd_height;
+			recorder = FrameRecorder::Create(emulator.argv_map, frame_width, frame_height, record_fps);
+			if (recorder) {
+				record_view.pixels.resize(lcd_width * lcd_height);
+				record_frame = SDL_CreateRGBSurfaceWithFormat(0, frame_width, frame_height, 32, SDL_PIXELFORMAT_ARGB8888);
+				if (!record_frame)
+					PANIC("SDL_CreateRGBSurfaceWithFormat failed: %s\n", SDL_GetError());
+				if (with_interface) {
+					record_interface = interface_argb;
+					interface_argb = nullptr;
+				}
+			}
+			if (interface_argb)
+				SDL_FreeSurface(interface_argb);
 			if constexpr (hardware_id == HW_TI) {
 				screen_buffer = new uint8_t[192 * 9];
 				// TODO: remove this
@@ -585,7 +666,7 @@ namespace casioemu {
 			}
 			else {
 				screen_buffer = new uint8_t[(N_ROW + 1) * ROW_SIZE];
-				fillRandomData(screen_buffer, (N_ROW + 1) * ROW_SIZE);
+				fillRandomData(screen_buffer, (N_ROW + 1) * ROW_SIZE, emulator.NextRandomSeed());
 			}
 			if constexpr (hardware_id == HW_CLASSWIZ || hardware_id == HW_CLASSWIZ_II) {
 				region_power.Setup(
@@ -606,7 +687,7 @@ namespace casioemu {
 			}
 			if constexpr (hardware_id == HW_CLASSWIZ_II) {
 				screen_buffer1 = new uint8_t[(N_ROW + 1) * ROW_SIZE];
-				fillRandomData(screen_buffer1, (N_ROW + 1) * ROW_SIZE);
+				fillRandomData(screen_buffer1, (N_ROW + 1) * ROW_SIZE, emulator.NextRandomSeed());
 			}
 			inited = true;
 		}
@@ -628,6 +709,7 @@ namespace casioemu {
 							std::cout << std::dec << off - 192 * 8 << " <- 0x" << std::hex << ti_port7 << "\n";
 						}
 						screen_buffer[off] = ti_port7;
+						vram_dirty = true;
 						ti_col++;
 						if (ti_col >= 192) {
 							ti_col = 0;
@@ -835,6 +917,7 @@ namespace casioemu {
 							}
 						}
 						screen->screen_mode = data & 127;
+						screen->vram_dirty = true;
 					},
 					emulator);
 			}
@@ -908,10 +991,11 @@ namespace casioemu {
 
 	template <HardwareId hardware_id>
 	void Screen<hardware_id>::Uninitialise() {
-		fillRandomData(screen_buffer, (N_ROW + 1) * ROW_SIZE);
+		fillRandomData(screen_buffer, (N_ROW + 1) * ROW_SIZE, emulator.NextRandomSeed());
 		if constexpr (hardware_id == HW_CLASSWIZ_II) {
-			fillRandomData(screen_buffer1, (N_ROW + 1) * ROW_SIZE);
+			fillRandomData(screen_buffer1, (N_ROW + 1) * ROW_SIZE, emulator.NextRandomSeed());
 		}
+		vram_dirty = true;
 		if constexpr (hardware_id != HW_CLASSWIZ_II) {
 			region_buffer.Kill();
 		}
@@ -950,38 +1034,278 @@ namespace casioemu {
 		}
 		enabled_2 = false;
 	}
+
+	template <HardwareId hardware_id>
+	void Screen<hardware_id>::SaveState(std::ostream& os) {
+		Binary::WriteAll(os, enabled_2, screen_power);
+		if constexpr (hardware_id == HW_TI) {
+			os.write((char*)screen_buffer, 192 * 9);
+		}
+		else {
+			os.write((char*)screen_buffer, (N_ROW + 1) * ROW_SIZE);
+		}
+		if constexpr (hardware_id == HW_CLASSWIZ_II) {
+			os.write((char*)screen_buffer1, (N_ROW + 1) * ROW_SIZE);
+		}
+		Binary::WriteAll(os, screen_contrast, screen_brightness, screen_contrast2, screen_mode, screen_range, screen_select, screen_offset, screen_refresh_rate, screen_contrast2_en, unk_f034);
+		Binary::WriteAll(os, ti_contrast, ti_port_status, ti_enabled, ti_a0, ti_rw, ti_col, ti_page, ti_port7, ti_port5);
+	}
+
+	template <HardwareId hardware_id>
+	void Screen<hardware_id>::LoadState(std::istream& is) {
+		// Bring the regions in line with the saved power state first, this clobbers the buffers.
+		bool was_enabled;
+		Binary::ReadAll(is, was_enabled, screen_power);
+		if (was_enabled && !enabled_2)
+			Initialise();
+		else if (!was_enabled && enabled_2)
+			Uninitialise();
+		if constexpr (hardware_id == HW_TI) {
+			is.read((char*)screen_buffer, 192 * 9);
+		}
+		else {
+			is.read((char*)screen_buffer, (N_ROW + 1) * ROW_SIZE);
+		}
+		if constexpr (hardware_id == HW_CLASSWIZ_II) {
+			is.read((char*)screen_buffer1, (N_ROW + 1) * ROW_SIZE);
+		}
+		Binary::ReadAll(is, screen_contrast, screen_brightness, screen_contrast2, screen_mode, screen_range, screen_select, screen_offset, screen_refresh_rate, screen_contrast2_en, unk_f034);
+		Binary::ReadAll(is, ti_contrast, ti_port_status, ti_enabled, ti_a0, ti_rw, ti_col, ti_page, ti_port7, ti_port5);
+		vram_dirty = true;
+		next_publish_tick = next_record_tick = emulator.chipset.ticks_elapsed;
+	}
+
 	template <HardwareId hardware_id>
 	void Screen<hardware_id>::Frame() {
+		published.Acquire();
+		auto& state = published.ReadBuffer();
+		bool update = NeedsUpdate(state);
+		if (update)
+			settle_residual *= Advance(view, state);
+		else
+			view.last_decay_time = state.time;
+
 		int x = 0;
 		if (!emulator.modeldef.enable_new_screen) {
 			SDL_SetTextureColorMod(interface_texture, ink_colour.r, ink_colour.g, ink_colour.b);
 		}
 		for (int ix = 1; ix != SPR_MAX; ++ix) {
-			SDL_SetTextureAlphaMod(interface_texture, Uint8(std::clamp((int)screen_ink_alpha[x], 0, 255)));
+			SDL_SetTextureAlphaMod(interface_texture, Uint8(std::clamp((int)view.ink_alpha[x], 0, 255)));
 			x++;
 			SDL_RenderCopy(renderer, interface_texture, &sprite_info[ix].src, &sprite_info[ix].dest);
 		}
-		static constexpr auto SPR_PIXEL = 0;
-		SDL_Rect dest = Screen<hardware_id>::sprite_info[SPR_PIXEL].dest;
+
+		if (!lcd_texture) {
+			lcd_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, lcd_width, lcd_height);
+			if (!lcd_texture)
+				PANIC("SDL_CreateTexture failed: %s\n", SDL_GetError());
+			SDL_SetTextureBlendMode(lcd_texture, SDL_BLENDMODE_BLEND);
+			update = true;
+		}
+		if (update) {
+			CompositeLCD(view);
+			SDL_UpdateTexture(lcd_texture, nullptr, view.pixels.data(), lcd_width * sizeof(Uint32));
+		}
+		SDL_Rect dest = LcdDest();
+		SDL_RenderCopy(renderer, lcd_texture, nullptr, &dest);
+	}
+
+	template <HardwareId hardware_id>
+	void Screen<hardware_id>::CaptureState(LcdState& state) {
+		auto stamp = VRAMStamp();
+		if (vram_dirty || stamp != vram_stamp) {
+			vram_dirty = false;
+			vram_stamp = stamp;
+			++vram_serial;
+		}
+		state.vram_serial = vram_serial;
+		state.time = emulator.GetEmulatedSeconds();
+		state.mode = screen_mode;
+		state.range = screen_range;
+		state.contrast = screen_contrast;
+		state.brightness = screen_brightness;
+		state.contrast2 = screen_contrast2;
+		state.contrast2_en = screen_contrast2_en;
+		state.select = screen_select;
+		state.offset = screen_offset;
+		state.refresh_rate = screen_refresh_rate;
+		state.power = screen_power;
+		state.enabled = enabled_2;
+		state.ti_enabled = ti_enabled;
+		state.ti_contrast = ti_contrast;
+		state.buffer_select = screen_buffer_select;
+		if constexpr (hardware_id == HW_TI) {
+			// Dot matrix in the first 8 pages, status row in the 9th.
+			state.row_size = 192;
+			if (emulator.modeldef.real_hardware) {
+				memcpy(state.plane0, screen_buffer, 192 * 9);
+			}
+			else if (GetRam()) {
+				auto ram = GetRam() - casioemu::GetRamBaseAddr(hardware_id);
+				memcpy(state.plane0, ram + 0xE708, 192 * 8);
+				memcpy(state.plane0 + 192 * 8, ram + 0xE5D4, 192);
+			}
+		}
+		else if (state.buffer_select != 0 && GetRam()) {
+			auto ram = GetRam() - casioemu::GetRamBaseAddr(hardware_id) + casioemu::GetScreenBufferOffset(emulator.hardware_id, state.buffer_select);
+			state.row_size = ROW_SIZE_DISP;
+			memcpy(state.plane0, ram, (N_ROW + 1) * ROW_SIZE_DISP);
+			if constexpr (hardware_id == HW_CLASSWIZ_II)
+				memcpy(state.plane1, ram + 0x600, (N_ROW + 1) * ROW_SIZE_DISP);
+		}
+		else {
+			state.buffer_select = 0;
+			state.row_size = ROW_SIZE;
+			memcpy(state.plane0, screen_buffer, (N_ROW + 1) * ROW_SIZE);
+			if constexpr (hardware_id == HW_CLASSWIZ_II)
+				memcpy(state.plane1, screen_buffer1, (N_ROW + 1) * ROW_SIZE);
+		}
+	}
+
+	template <HardwareId hardware_id>
+	void Screen<hardware_id>::PublishState() {
+		auto& state = published.WriteBuffer();
+		CaptureState(state);
+		auto signature = StateSignature(state);
+		if (state.vram_serial != published_serial || signature != published_signature) {
+			published_serial = state.vram_serial;
+			published_signature = signature;
+			settle_until = state.time + std::log(1024.0) / (-std::log((double)decay_ratio()) * decay_steps_per_second);
+		}
+		bool flashing = hardware_id != HW_TI && std::max<int>(state.refresh_rate, 6) >= screen_flashing_threshold;
+		published.Publish();
+		if (flashing || state.time <= settle_until)
+			RaiseEvent(emulator.hooks.on_screen_changed, emulator);
+	}
+
+	template <HardwareId hardware_id>
+	float Screen<hardware_id>::Advance(LcdView& v, const LcdState& state) {
+		double steps = std::max(0.0, state.time - v.last_decay_time) * decay_steps_per_second;
+		v.last_decay_time = state.time;
+		float keep = std::pow(decay_ratio(), (float)steps);
+		tick(v, state, keep);
+		return keep;
+	}
+
+	template <HardwareId hardware_id>
+	void Screen<hardware_id>::RecordFrame() {
+		CaptureState(record_state);
+		Advance(record_view, record_state);
+		CompositeLCD(record_view);
+		SDL_Surface* lcd = SDL_CreateRGBSurfaceWithFormatFrom(record_view.pixels.data(), lcd_width, lcd_height, 32, lcd_width * sizeof(Uint32), SDL_PIXELFORMAT_ARGB8888);
+		if (!lcd)
+			return;
+		SDL_SetSurfaceBlendMode(lcd, SDL_BLENDMODE_BLEND);
+		SDL_Rect lcd_dest{0, 0, lcd_width, lcd_height};
+		if (record_interface) {
+			// Same layering as Emulator::Frame: body, status sprites, dot matrix.
+			SDL_SetSurfaceBlendMode(record_interface, SDL_BLENDMODE_NONE);
+			SDL_SetSurfaceColorMod(record_interface, 255, 255, 255);
+			SDL_SetSurfaceAlphaMod(record_interface, 255);
+			SDL_BlitScaled(record_interface, &emulator.interface_background.src, record_frame, nullptr);
+			SDL_SetSurfaceBlendMode(record_interface, SDL_BLENDMODE_BLEND);
+			if (!emulator.modeldef.enable_new_screen)
+				SDL_SetSurfaceColorMod(record_interface, ink_colour.r, ink_colour.g, ink_colour.b);
+			for (int ix = 1; ix != SPR_MAX; ++ix) {
+				SDL_SetSurfaceAlphaMod(record_interface, Uint8(std::clamp((int)record_view.ink_alpha[ix - 1], 0, 255)));
+				SDL_BlitScaled(record_interface, &sprite_info[ix].src, record_frame, &sprite_info[ix].dest);
+			}
+			lcd_dest = LcdDest();
+		}
+		else {
+			SDL_FillRect(record_frame, nullptr, 0xFFFFFFFF);
+		}
+		SDL_BlitScaled(lcd, nullptr, record_frame, &lcd_dest);
+		SDL_FreeSurface(lcd);
+		recorder->WriteFrame(record_frame);
+	}
+
+	template <HardwareId hardware_id>
+	void Screen<hardware_id>::ReadFramebuffer(std::vector<uint32_t>& pixels, int& width, int& height) {
+		if (framebuffer_view.pixels.empty())
+			framebuffer_view.pixels.resize(lcd_width * lcd_height);
+		CaptureState(framebuffer_state);
+		Advance(framebuffer_view, framebuffer_state);
+		CompositeLCD(framebuffer_view);
+		pixels.assign(framebuffer_view.pixels.begin(), framebuffer_view.pixels.end());
+		width = lcd_width;
+		height = lcd_height;
+	}
+
+	template <HardwareId hardware_id>
+	uint64_t Screen<hardware_id>::VRAMStamp() {
+		auto& mmu = emulator.chipset.mmu;
+		if constexpr (hardware_id == HW_TI) {
+			if (emulator.modeldef.real_hardware)
+				return 0; // only written through the port callbacks
+			return std::max(mmu.GetRangeStamp(0xE708, 192 * 8), mmu.GetRangeStamp(0xE5D4, 0x100));
+		}
+		else {
+			size_t size = (N_ROW + 1) * ROW_SIZE;
+			if (screen_buffer_select != 0)
+				return mmu.GetRangeStamp(casioemu::GetScreenBufferOffset(emulator.hardware_id, screen_buffer_select), hardware_id == HW_CLASSWIZ_II ? 0x600 + size : size);
+			uint64_t stamp = mmu.GetRangeStamp(0xF800, size);
+			if constexpr (hardware_id == HW_CLASSWIZ_II)
+				stamp = std::max(stamp, mmu.GetRangeStamp(0x89000, size));
+			return stamp;
+		}
+	}
+
+	template <HardwareId hardware_id>
+	std::array<int, 16> Screen<hardware_id>::StateSignature(const LcdState& state) {
+		int coeff_bits;
+		memcpy(&coeff_bits, &screen_flashing_brightness_coeff, sizeof(coeff_bits));
+		return {state.mode, state.range, state.contrast, state.brightness, state.contrast2, state.contrast2_en,
+			state.select, state.offset, state.refresh_rate, state.power, state.enabled, state.ti_enabled, state.ti_contrast,
+			state.buffer_select, screen_flashing_threshold, coeff_bits};
+	}
+
+	template <HardwareId hardware_id>
+	bool Screen<hardware_id>::NeedsUpdate(const LcdState& state) {
+		auto signature = StateSignature(state);
+		if (state.vram_serial != shown_vram_serial || signature != last_signature) {
+			shown_vram_serial = state.vram_serial;
+			last_signature = signature;
+			settle_residual = 1;
+			return true;
+		}
+		// The scan line animation never settles.
+		if constexpr (hardware_id != HW_TI)
+			if (std::max<int>(state.refresh_rate, 6) >= screen_flashing_threshold)
+				return true;
+		// Done once what's left of the last change is below one alpha step.
+		return settle_residual > 1.0f / 1024;
+	}
+
+	template <HardwareId hardware_id>
+	void Screen<hardware_id>::CompositeLCD(LcdView& v) {
+		auto& src = sprite_info[0].src;
 		for (int iy2 = 1; iy2 != (N_ROW + 1); ++iy2) {
-			int x = 0;
-			dest.x = sprite_info[SPR_PIXEL].dest.x;
-			dest.y = sprite_info[SPR_PIXEL].dest.y + (iy2 - 1) * sprite_info[SPR_PIXEL].src.h;
-			for (int ix = 0; ix != ROW_SIZE_DISP; ++ix) {
-				for (uint8_t mask = 0x80; mask; mask >>= 1, dest.x += sprite_info[SPR_PIXEL].src.w) {
-					if (screen_ink_alpha[x + iy2 * 192] > 255) {
-						SDL_SetTextureColorMod(interface_texture,
-							std::max(0, ink_colour.r - (int)(screen_ink_alpha[x + iy2 * 192] - 255)),
-							std::max(0, ink_colour.g - (int)((screen_ink_alpha[x + iy2 * 192] - 255) * 0.8)),
-							std::max(0, ink_colour.b - (int)((screen_ink_alpha[x + iy2 * 192] - 255) * 0.1)));
-						SDL_SetTextureAlphaMod(interface_texture, 255);
-					}
-					else {
-						SDL_SetTextureColorMod(interface_texture, ink_colour.r, ink_colour.g, ink_colour.b);
-						SDL_SetTextureAlphaMod(interface_texture, Uint8(std::clamp((int)screen_ink_alpha[x + iy2 * 192], 0, 255)));
+			Uint32* row = v.pixels.data() + (iy2 - 1) * src.h * lcd_width;
+			for (int x = 0; x != ROW_SIZE_DISP * 8; ++x) {
+				// Same colour/alpha modulation the per-dot render copies used to apply.
+				float ink_alpha = v.ink_alpha[x + iy2 * 192];
+				int r = ink_colour.r, g = ink_colour.g, b = ink_colour.b, a;
+				if (ink_alpha > 255) {
+					r = std::max(0, ink_colour.r - (int)(ink_alpha - 255));
+					g = std::max(0, ink_colour.g - (int)((ink_alpha - 255) * 0.8));
+					b = std::max(0, ink_colour.b - (int)((ink_alpha - 255) * 0.1));
+					a = 255;
+				}
+				else {
+					a = std::clamp((int)ink_alpha, 0, 255);
+				}
+				Uint32* cell = row + x * src.w;
+				for (int sy = 0; sy != src.h; ++sy, cell += lcd_width) {
+					const Uint32* texel = pixel_sprite.data() + sy * src.w;
+					for (int sx = 0; sx != src.w; ++sx) {
+						if (!a) {
+							cell[sx] = 0;
+							continue;
+						}
+						Uint32 t = texel[sx];
+						cell[sx] = ((t >> 24) * a / 255) << 24 | (((t >> 16) & 0xFF) * r / 255) << 16 | (((t >> 8) & 0xFF) * g / 255) << 8 | ((t & 0xFF) * b / 255);
 					}
-					x++;
-					SDL_RenderCopy(renderer, interface_texture, &sprite_info[SPR_PIXEL].src, &dest);
 				}
 			}
 		}
@@ -1,4 +1,17 @@
 ﻿#pragma once
+#include <cstdint>
+#include <vector>
 namespace casioemu {
 	class Peripheral* CreateScreen(class Emulator& emulator);
-}
\ No newline at end of file
+}
+/**
+ * Software framebuffer of the dot matrix, composited on the CPU so it works without a window.
+ * Call on the emulation thread only, e.g. through Emulator::Call.
+ */
+class IFramebuffer {
+public:
+	/**
+	 * Fills `pixels` with the LCD as it looks now (ARGB8888, row major) and its size.
+	 */
+	virtual void ReadFramebuffer(std::vector<uint32_t>& pixels, int& width, int& height) = 0;
+};
\ No newline at end of file
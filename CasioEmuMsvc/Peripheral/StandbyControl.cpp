@@ -16,6 +16,8 @@ namespace casioemu {
 
 		void Initialise();
 		void Reset();
+		void SaveState(std::ostream& os) override;
+		void LoadState(std::istream& is) override;
 	};
 	void StandbyControl::Initialise() {
 		region_stpacp.Setup(
@@ -78,6 +80,14 @@ namespace casioemu {
 		stop_acceptor_enabled = false;
 		shutdown_acceptor_enabled = false;
 	}
+
+	void StandbyControl::SaveState(std::ostream& os) {
+		Binary::WriteAll(os, stpacp_last, F312_last, stop_acceptor_enabled, shutdown_acceptor_enabled);
+	}
+
+	void StandbyControl::LoadState(std::istream& is) {
+		Binary::ReadAll(is, stpacp_last, F312_last, stop_acceptor_enabled, shutdown_acceptor_enabled);
+	}
 	Peripheral* CreateStbCtrl(Emulator& emu) {
 		return new StandbyControl(emu);
 	}
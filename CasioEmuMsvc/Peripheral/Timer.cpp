@@ -30,6 +30,8 @@ namespace casioemu {
 		void Reset();
 		void Tick();
 		void Uninitialise();
+		void SaveState(std::ostream& os) override;
+		void LoadState(std::istream& is) override;
 	};
 	void Timer::Initialise() {
 		if (enabled)
@@ -41,10 +43,10 @@ namespace casioemu {
 
 		TimerFreqDiv = 1;
 		if (emulator.modeldef.real_hardware) {
-			clock_type = CLOCK_LSCLK;
+			SetClockType(CLOCK_LSCLK);
 		}
 		else {
-			clock_type = CLOCK_EMUCLK;
+			SetClockType(CLOCK_EMUCLK);
 		}
 
 		block_bit = 3;
@@ -83,9 +85,9 @@ namespace casioemu {
 				timer->TimerFreqDiv = std::pow(2, data & 0x07);
 				if (timer->emulator.modeldef.real_hardware) {
 					if (data & 0x08)
-						timer->clock_type = CLOCK_HSCLK;
+						timer->SetClockType(CLOCK_HSCLK);
 					else
-						timer->clock_type = CLOCK_LSCLK;
+						timer->SetClockType(CLOCK_LSCLK);
 				}
 			},
 			emulator);
@@ -143,13 +145,21 @@ namespace casioemu {
 
 		enabled = false;
 
-		clock_type = CLOCK_STOPPED;
+		SetClockType(CLOCK_STOPPED);
 
 		region_interval.Kill();
 		region_counter.Kill();
 		region_F024.Kill();
 		region_control.Kill();
 	}
+
+	void Timer::SaveState(std::ostream& os) {
+		Binary::WriteAll(os, data_counter, data_interval, data_F024, data_control, ext_to_int_counter, TimerFreqDiv);
+	}
+
+	void Timer::LoadState(std::istream& is) {
+		Binary::ReadAll(is, data_counter, data_interval, data_F024, data_control, ext_to_int_counter, TimerFreqDiv);
+	}
 	template <typename ReadFunc, typename WriteFunc>
 		requires requires(ReadFunc read, WriteFunc write, MMURegion* reg, size_t off, uint8_t dat) {
 			{ read(reg, off) } -> std::same_as<uint8_t>;
@@ -198,6 +208,12 @@ namespace casioemu {
 					emulator.chipset.RaiseMaskable(int_map[i]);
 				}
 			}
+			void SaveState(std::ostream& os) {
+				Binary::WriteAll(os, tm_data_d, tm_counter_d, tm_mode_d, tm_int_stat_d, tm_int_clr_d, tm_cnt, started);
+			}
+			void LoadState(std::istream& is) {
+				Binary::ReadAll(is, tm_data_d, tm_counter_d, tm_mode_d, tm_int_stat_d, tm_int_clr_d, tm_cnt, started);
+			}
 		};
 		TimerUnit Units[8]{0,1,2,3,4,5,6,7};
 		MMURegion TMStart{};
@@ -219,6 +235,16 @@ namespace casioemu {
 			//	emulator.chipset.data_LTBR++;
 			//}
 		}
+		void SaveState(std::ostream& os) override {
+			for (auto& unit : Units)
+				unit.SaveState(os);
+			Binary::Write(os, a);
+		}
+		void LoadState(std::istream& is) override {
+			for (auto& unit : Units)
+				unit.LoadState(is);
+			Binary::Read(is, a);
+		}
 	};
 	Peripheral* CreateTimer(Emulator& emu) {
 		if (emu.hardware_id == HW_TI) {
@@ -24,9 +24,11 @@ namespace casioemu {
 		void Reset();
 		void Tick();
 		void ResetLSCLK();
+		void SaveState(std::ostream& os) override;
+		void LoadState(std::istream& is) override;
 	};
 	void TimerBaseCounter::Initialise() {
-		clock_type = CLOCK_LSCLK;
+		SetClockType(CLOCK_LSCLK);
 
 		LTBRCounter = 0;
 		current_output = 0;
@@ -73,6 +75,14 @@ namespace casioemu {
 		emulator.chipset.MaskableInterrupts[L4096SINT].TryRaise();
 		emulator.chipset.MaskableInterrupts[L16384SINT].TryRaise();
 	}
+
+	void TimerBaseCounter::SaveState(std::ostream& os) {
+		Binary::WriteAll(os, current_output, LTBR_reset_tick, LTBRCounter);
+	}
+
+	void TimerBaseCounter::LoadState(std::istream& is) {
+		Binary::ReadAll(is, current_output, LTBR_reset_tick, LTBRCounter);
+	}
 	class TBC2 : public Peripheral {
 		size_t LTB0INT = 55; // See Chipset.cpp
 		size_t LTB1INT = 56;
@@ -94,7 +104,7 @@ namespace casioemu {
 		using Peripheral::Peripheral;
 
 		void Initialise() {
-			clock_type = CLOCK_LSCLK;
+			SetClockType(CLOCK_LSCLK);
 
 			reg_LTBINT.Setup(
 				0xF064, 2, "TimerBaseCounter/LTBINT", this,
@@ -154,6 +164,12 @@ namespace casioemu {
 			emulator.chipset.MaskableInterrupts[LTB1INT].TryRaise();
 			emulator.chipset.MaskableInterrupts[LTB2INT].TryRaise();
 		}
+		void SaveState(std::ostream& os) override {
+			Binary::WriteAll(os, current_output, LTBR_reset_tick, LTBRCounter, LTB0S, LTB1S, LTB2S);
+		}
+		void LoadState(std::istream& is) override {
+			Binary::ReadAll(is, current_output, LTBR_reset_tick, LTBRCounter, LTB0S, LTB1S, LTB2S);
+		}
 	};
 	Peripheral* CreateTimerBaseCounter(Emulator& emu) {
 		if (emu.hardware_id == HW_TI) {
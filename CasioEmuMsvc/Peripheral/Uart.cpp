@@ -1,4 +1,5 @@
-﻿#include "Peripheral.hpp"
+﻿#include "Binary.h"
+#include "Peripheral.hpp"
 #include <MMURegion.hpp>
 namespace casioemu {
 	class Uart : public Peripheral {
@@ -29,6 +30,12 @@ namespace casioemu {
 		void Tick() {
 
 		}
+		void SaveState(std::ostream& os) override {
+			Binary::WriteAll(os, uart_control, uart_mod0, uart_mod1, uart_baud, uart_buf, uart_status);
+		}
+		void LoadState(std::istream& is) override {
+			Binary::ReadAll(is, uart_control, uart_mod0, uart_mod1, uart_baud, uart_buf, uart_status);
+		}
 	};
 	Peripheral* CreateUart(Emulator& emu) {
 		return new Uart(emu);
@@ -23,10 +23,12 @@ namespace casioemu {
 		void Initialise();
 		void Reset();
 		void Tick();
+		void SaveState(std::ostream& os) override;
+		void LoadState(std::istream& is) override;
 	};
 	void WatchdogTimer::Initialise() {
 		// Watchdog timer is normally disabled in casio calculators, but in some models parts of its function is reserved.
-		clock_type = emulator.chipset.WDT_enabled ? CLOCK_HSCLK : CLOCK_STOPPED;
+		SetClockType(emulator.chipset.WDT_enabled ? CLOCK_HSCLK : CLOCK_STOPPED);
 
 		data_WDTCON = 0;
 		data_WDTMOD = 2;
@@ -80,6 +82,14 @@ namespace casioemu {
 		WDT_counter = 0;
 		overflow_count = false;
 	}
+
+	void WatchdogTimer::SaveState(std::ostream& os) {
+		Binary::WriteAll(os, data_WDTCON, data_WDTMOD, data_WDP, WDT_counter, overflow_count);
+	}
+
+	void WatchdogTimer::LoadState(std::istream& is) {
+		Binary::ReadAll(is, data_WDTCON, data_WDTMOD, data_WDP, WDT_counter, overflow_count);
+	}
 	Peripheral* CreateWatchdog(Emulator& emu) {
 		return new WatchdogTimer(emu);
 	}
@@ -0,0 +1,325 @@
+﻿#include "RewindBuffer.hpp"
+
+#include "Chipset/Chipset.hpp"
+#include "Chipset/MMU.hpp"
+#include "Emulator.hpp"
+#include "Logger.hpp"
+#include "Peripheral/BatteryBackedRAM.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace casioemu {
+	static const size_t npos = (size_t)-1;
+
+	RewindBuffer::RewindBuffer(Emulator& _emulator, size_t _budget, unsigned int _interval) : emulator(_emulator), budget(_budget), interval(_interval) {
+	}
+
+	template <typename F>
+	void RewindBuffer::ForEachWrittenPage(F visit) {
+		auto ram = emulator.chipset.QueryInterface<IRam>();
+		if (!ram)
+			return;
+		auto& mmu = emulator.chipset.mmu;
+		const size_t page_size = (size_t)1 << MMU::page_shift;
+		auto& ranges = ram->GetRanges();
+		for (size_t index = 0; index != ranges.size(); ++index) {
+			auto& range = ranges[index];
+			for (size_t offset = 0, end; offset != range.size; offset = end) {
+				// Pages are aligned in the address space, a range needn't be.
+				end = std::min(range.size, (range.base + offset) / page_size * page_size + page_size - range.base);
+				if (mmu.GetRangeStamp(range.base + offset, end - offset) > last_stamp)
+					visit(index, offset, end - offset);
+			}
+		}
+	}
+
+	template <typename F>
+	void RewindBuffer::ForEachWrittenImagePage(size_t index, RomImage& image, F visit) {
+		if (image.GetWriteStamp() == image_stamps[index])
+			return;
+		const size_t page_size = (size_t)1 << RomImage::page_shift;
+		for (size_t offset = 0; offset < image.size(); offset += page_size) {
+			size_t size = std::min(page_size, image.size() - offset);
+			if (image.GetRangeStamp(offset, size) > image_stamps[index])
+				visit(offset, size);
+		}
+	}
+
+	std::string RewindBuffer::SaveCore() {
+		std::ostringstream os;
+		emulator.SaveState(os, false);
+		return os.str();
+	}
+
+	void RewindBuffer::Poll(bool commands_ran) {
+		auto& chipset = emulator.chipset;
+		if (!commands_ran && !checkpoints.empty() && chipset.ticks_elapsed - checkpoints.back().ticks < (uint64_t)emulator.GetCyclesPerSecond() * interval / 1000)
+			return;
+		Take(SaveCore());
+	}
+
+	void RewindBuffer::Take(std::string core) {
+		auto& chipset = emulator.chipset;
+		auto ram = chipset.QueryInterface<IRam>();
+		// Nothing ran since the newest checkpoint, this one replaces it. Its events carry over to
+		// the previous checkpoint, and so do the pages it changed: an undo list is applied last
+		// entry first, so the oldest contents of a page win.
+		if (!checkpoints.empty() && checkpoints.back().ticks == chipset.ticks_elapsed) {
+			auto events = std::move(checkpoints.back().events);
+			Drop(checkpoints.back());
+			checkpoints.pop_back();
+			if (!checkpoints.empty()) {
+				auto& previous = checkpoints.back().events;
+				previous.insert(previous.end(), events.begin(), events.end());
+				used += events.size() * sizeof(Event);
+			}
+		}
+
+		Checkpoint checkpoint;
+		checkpoint.ticks = chipset.ticks_elapsed;
+		checkpoint.instructions = chipset.instructions_executed;
+		checkpoint.seconds = emulator.GetEmulatedSeconds();
+		checkpoint.core = std::move(core);
+		checkpoint.bytes = sizeof(Checkpoint) + checkpoint.core.size();
+		checkpoint.undo_bytes = 0;
+
+		RomImage* images[] = {&chipset.rom_data, &chipset.flash_data};
+		for (size_t i = 0; i != 2; ++i)
+			checkpoint.images_shared[i] = images[i]->IsShared();
+
+		if (checkpoints.empty()) {
+			shadow.clear();
+			if (ram)
+				for (auto& range : ram->GetRanges())
+					shadow.emplace_back(range.data, range.data + range.size);
+			for (size_t i = 0; i != 2; ++i) {
+				image_shadow[i].clear();
+				if (!images[i]->IsShared())
+					image_shadow[i].assign(images[i]->data(), images[i]->data() + images[i]->size());
+			}
+		}
+		else {
+			auto& previous = checkpoints.back();
+			ForEachWrittenPage([&](size_t index, size_t offset, size_t size) {
+				auto data = ram->GetRanges()[index].data + offset;
+				auto old = shadow[index].data() + offset;
+				// Written back to what it was is no change.
+				if (!memcmp(data, old, size))
+					return;
+				previous.undo.push_back({index, offset, std::vector<uint8_t>(old, old + size)});
+				previous.undo_bytes += sizeof(Page) + size;
+				used += sizeof(Page) + size;
+				memcpy(old, data, size);
+			});
+			for (size_t i = 0; i != 2; ++i) {
+				auto& image = *images[i];
+				ForEachWrittenImagePage(i, image, [&](size_t offset, size_t size) {
+					// Unchanged from the original as of the newest checkpoint.
+					if (image_shadow[i].empty())
+						image_shadow[i].assign(image.Original(), image.Original() + image.size());
+					auto data = image.data() + offset;
+					auto old = image_shadow[i].data() + offset;
+					if (!memcmp(data, old, size))
+						return;
+					previous.image_undo.push_back({i, offset, std::vector<uint8_t>(old, old + size)});
+					previous.undo_bytes += sizeof(Page) + size;
+					used += sizeof(Page) + size;
+					memcpy(old, data, size);
+				});
+			}
+		}
+		last_stamp = chipset.mmu.GetWriteStamp();
+		for (size_t i = 0; i != 2; ++i)
+			image_stamps[i] = images[i]->GetWriteStamp();
+
+		used += checkpoint.bytes;
+		checkpoints.push_back(std::move(checkpoint));
+		while (used > budget && checkpoints.size() > 1) {
+			Drop(checkpoints.front());
+			checkpoints.pop_front();
+		}
+		span = checkpoints.back().seconds - checkpoints.front().seconds;
+	}
+
+	void RewindBuffer::Drop(Checkpoint& checkpoint) {
+		used -= checkpoint.bytes + checkpoint.undo_bytes + checkpoint.events.size() * sizeof(Event);
+	}
+
+	void RewindBuffer::Restore(size_t index) {
+		auto& chipset = emulator.chipset;
+		auto ram = chipset.QueryInterface<IRam>();
+		// Back to the newest checkpoint, then undo what every later one changed.
+		ForEachWrittenPage([&](size_t range, size_t offset, size_t size) {
+			memcpy(ram->GetRanges()[range].data + offset, shadow[range].data() + offset, size);
+		});
+		RomImage* images[] = {&chipset.rom_data, &chipset.flash_data};
+		for (size_t i = 0; i != 2; ++i) {
+			auto& image = *images[i];
+			// No shadow yet means the image was still the original at the newest checkpoint.
+			ForEachWrittenImagePage(i, image, [&](size_t offset, size_t size) {
+				auto old = image_shadow[i].empty() ? image.Original() : image_shadow[i].data();
+				memcpy(image.MakeWritable(offset, size) + offset, old + offset, size);
+			});
+		}
+		for (size_t i = checkpoints.size() - 1; i-- > index;) {
+			for (auto it = checkpoints[i].undo.rbegin(); it != checkpoints[i].undo.rend(); ++it) {
+				memcpy(ram->GetRanges()[it->range].data + it->offset, it->data.data(), it->data.size());
+				memcpy(shadow[it->range].data() + it->offset, it->data.data(), it->data.size());
+			}
+			for (auto it = checkpoints[i].image_undo.rbegin(); it != checkpoints[i].image_undo.rend(); ++it) {
+				auto& image = *images[it->range];
+				if (!checkpoints[index].images_shared[it->range])
+					memcpy(image.MakeWritable(it->offset, it->data.size()) + it->offset, it->data.data(), it->data.size());
+				memcpy(image_shadow[it->range].data() + it->offset, it->data.data(), it->data.size());
+			}
+		}
+		while (checkpoints.size() > index + 1) {
+			Drop(checkpoints.back());
+			checkpoints.pop_back();
+		}
+		auto& checkpoint = checkpoints.back();
+		used -= checkpoint.undo_bytes;
+		checkpoint.undo.clear();
+		checkpoint.image_undo.clear();
+		checkpoint.undo_bytes = 0;
+
+		std::istringstream is(checkpoint.core);
+		emulator.LoadState(is, false);
+		for (size_t i = 0; i != 2; ++i) {
+			if (checkpoint.images_shared[i])
+				images[i]->Discard();
+			image_stamps[i] = images[i]->GetWriteStamp();
+		}
+		last_stamp = chipset.mmu.GetWriteStamp();
+		span = checkpoint.seconds - checkpoints.front().seconds;
+	}
+
+	size_t RewindBuffer::Before(uint64_t instructions) {
+		for (size_t index = checkpoints.size(); index--;)
+			if (checkpoints[index].instructions < instructions)
+				return index;
+		return npos;
+	}
+
+	bool RewindBuffer::Replay(uint64_t instructions, uint64_t ticks, const std::function<bool()>* hit, uint64_t* last_hit) {
+		auto& chipset = emulator.chipset;
+		auto& checkpoint = checkpoints.back();
+		auto& events = checkpoint.events;
+		// It all happened before, the debugger and scripts saw it then.
+		auto hooks = std::move(emulator.hooks);
+		emulator.hooks = {};
+		size_t next = 0;
+		while (chipset.instructions_executed < instructions && chipset.ticks_elapsed < ticks) {
+			for (; next != events.size() && events[next].ticks <= chipset.ticks_elapsed; ++next) {
+				if (events[next].key_wait)
+					chipset.ti_key_wait_cycles = events[next].key_wait_cycles;
+				else
+					chipset.EmulatorTick();
+			}
+			auto executed = chipset.instructions_executed;
+			// Not Emulator::Tick, a replay doesn't count towards RunFor.
+			chipset.Tick();
+			if (hit && chipset.instructions_executed != executed && (*hit)())
+				*last_hit = chipset.instructions_executed;
+		}
+		emulator.hooks = std::move(hooks);
+		used -= (events.size() - next) * sizeof(Event);
+		events.resize(next);
+		if (chipset.instructions_executed != instructions) {
+			logger::Info("[Rewind][Error] Replay diverged at instruction %llu\n", (unsigned long long)chipset.instructions_executed);
+			return false;
+		}
+		return true;
+	}
+
+	void RewindBuffer::Clear() {
+		checkpoints.clear();
+		shadow.clear();
+		for (auto& image : image_shadow)
+			image.clear();
+		used = 0;
+		span = 0;
+	}
+
+	void RewindBuffer::NoteEmulatorTick() {
+		if (checkpoints.empty())
+			return;
+		checkpoints.back().events.push_back({emulator.chipset.ticks_elapsed, false, 0});
+		used += sizeof(Event);
+	}
+
+	void RewindBuffer::NoteKeyWait() {
+		if (checkpoints.empty())
+			return;
+		checkpoints.back().events.push_back({emulator.chipset.ticks_elapsed, true, emulator.chipset.ti_key_wait_cycles});
+		used += sizeof(Event);
+	}
+
+	bool RewindBuffer::Rewind(double seconds) {
+		if (checkpoints.empty())
+			return false;
+		double target = emulator.GetEmulatedSeconds() - seconds;
+		size_t index = checkpoints.size() - 1;
+		while (index && checkpoints[index].seconds > target)
+			--index;
+		Restore(index);
+		auto& checkpoint = checkpoints.back();
+		used -= checkpoint.events.size() * sizeof(Event);
+		checkpoint.events.clear();
+		logger::Info("[Rewind][Info] Back to %.2f s\n", checkpoint.seconds);
+		return true;
+	}
+
+	bool RewindBuffer::StepBack() {
+		auto& chipset = emulator.chipset;
+		size_t index = chipset.instructions_executed ? Before(chipset.instructions_executed - 1) : npos;
+		if (index == npos) {
+			logger::Info("[Rewind][Info] No earlier instruction in the buffer\n");
+			return false;
+		}
+		auto target = chipset.instructions_executed - 1;
+		auto ticks = chipset.ticks_elapsed;
+		Restore(index);
+		return Replay(target, ticks);
+	}
+
+	bool RewindBuffer::ContinueBack(const std::function<bool()>& stop) {
+		auto& chipset = emulator.chipset;
+		size_t index = Before(chipset.instructions_executed);
+		if (index == npos) {
+			logger::Info("[Rewind][Info] No earlier instruction in the buffer\n");
+			return false;
+		}
+		// Search one checkpoint interval at a time, newest first, then go to the last hit.
+		uint64_t limit = chipset.instructions_executed - 1, limit_ticks = chipset.ticks_elapsed;
+		while (true) {
+			if (checkpoints[index].instructions < limit) {
+				uint64_t hit = 0;
+				Restore(index);
+				if (!Replay(limit, limit_ticks, &stop, &hit))
+					return false;
+				if (hit) {
+					Restore(index);
+					return Replay(hit, limit_ticks);
+				}
+			}
+			if (!index)
+				break;
+			limit = checkpoints[index].instructions;
+			limit_ticks = checkpoints[index].ticks;
+			--index;
+		}
+		Restore(0);
+		auto& checkpoint = checkpoints.back();
+		used -= checkpoint.events.size() * sizeof(Event);
+		checkpoint.events.clear();
+		logger::Info("[Rewind][Info] No earlier stop in the buffer, back at its start\n");
+		return true;
+	}
+
+	double RewindBuffer::GetSpan() {
+		return span;
+	}
+} // namespace casioemu
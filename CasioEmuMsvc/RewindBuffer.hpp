@@ -0,0 +1,138 @@
+﻿#pragma once
+#include "Config.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace casioemu {
+	class Emulator;
+	class RomImage;
+
+	/**
+	 * Keeps the last stretch of emulation in memory so it can be rewound. Set up by `rewind=<MB>`,
+	 * the memory budget (32 by default with a window, 0 headless and in batch jobs, 0 turns it
+	 * off), and `rewind_interval=<ms>`, the emulated time between checkpoints (100 by default).
+	 *
+	 * A checkpoint holds the core state (Chipset::SaveCoreState) but no copy of RAM. `shadow` is RAM
+	 * as of the newest checkpoint; taking the next one compares only the pages the MMU saw written
+	 * since, and the old contents of those that changed become the undo list of the previous
+	 * checkpoint. ROM and flash images are handled the same way with the pages RomImage saw written
+	 * (firmware flashing), their shadows only filled in once they were first written. Rewinding puts
+	 * the shadows back and applies the undo lists newest first. The oldest checkpoints are dropped
+	 * to stay within the budget.
+	 *
+	 * Between two checkpoints the machine only depends on what the tick thread does at slice
+	 * boundaries. Commands get a checkpoint right after them, unless posted as Emulator::Query; the EMUCLK
+	 * ticks and the TI key wait, both paced by the host clock, are kept in the checkpoint's
+	 * `events` with the tick they happened at. So any instruction since the oldest checkpoint can
+	 * be reached again by restoring the checkpoint before it and re-executing, which is how the code
+	 * viewer steps backwards. The default interval keeps that under 100 ms of emulated time.
+	 *
+	 * RAM writes that bypass the MMU aren't seen. The RAM image is loaded before the first
+	 * checkpoint, debugger edits and the injector go through MMU::WriteData, and loading a full
+	 * state clears the buffer. Everything but GetSpan runs on the emulation thread.
+	 */
+	class RewindBuffer {
+		struct Page {
+			size_t range, offset;
+			std::vector<uint8_t> data;
+		};
+		struct Event {
+			uint64_t ticks;
+			bool key_wait;			  // otherwise an EMUCLK tick
+			uint64_t key_wait_cycles; // what WaitForKey left
+		};
+		struct Checkpoint {
+			uint64_t ticks, instructions;
+			double seconds;
+			std::string core;
+			bool images_shared[2]; // ROM and flash still the shared images (RomImage::IsShared)
+			size_t bytes;
+			// What happened until the next checkpoint. Empty on the newest one until then.
+			std::vector<Page> undo;
+			std::vector<Page> image_undo; // `range` is the image, 0 ROM and 1 flash
+			size_t undo_bytes;
+			std::vector<Event> events;
+		};
+
+		Emulator& emulator;
+		size_t budget, used = 0;
+		unsigned int interval;
+		std::deque<Checkpoint> checkpoints;
+		std::vector<std::vector<uint8_t>> shadow;
+		uint64_t last_stamp = 0;
+		// Empty while the image is unchanged from RomImage::Original.
+		std::vector<uint8_t> image_shadow[2];
+		uint64_t image_stamps[2]{};
+		std::atomic<double> span{0};
+
+		std::string SaveCore();
+		void Take(std::string core);
+		void Drop(Checkpoint& checkpoint);
+		void Restore(size_t index);
+		/**
+		 * Index of the newest checkpoint taken before instruction number `instructions` ran, or
+		 * npos if that's older than the buffer.
+		 */
+		size_t Before(uint64_t instructions);
+		/**
+		 * Re-executes from the newest checkpoint, just restored, until instruction number
+		 * `instructions` ran, giving up past `ticks`, and drops the events after that point. Hooks
+		 * don't fire meanwhile. `hit`, if given, is asked after every instruction and the number of
+		 * the last one it accepted is stored in `last_hit`.
+		 */
+		bool Replay(uint64_t instructions, uint64_t ticks, const std::function<bool()>* hit = nullptr, uint64_t* last_hit = nullptr);
+		/**
+		 * Calls `visit(range, offset, size)` for every page of RAM written since the newest checkpoint.
+		 */
+		template <typename F>
+		void ForEachWrittenPage(F visit);
+		/**
+		 * Calls `visit(offset, size)` for every page of image `index` written since the newest checkpoint.
+		 */
+		template <typename F>
+		void ForEachWrittenImagePage(size_t index, RomImage& image, F visit);
+
+	public:
+		RewindBuffer(Emulator& emulator, size_t budget, unsigned int interval);
+
+		/**
+		 * Takes a checkpoint if `commands_ran` (replay can't get past a command) or once `interval`
+		 * emulated milliseconds passed. Called between instruction slices, right after the commands.
+		 */
+		void Poll(bool commands_ran);
+		void Clear();
+		/**
+		 * Record what the tick thread did at the current tick besides executing, see Replay.
+		 */
+		void NoteEmulatorTick();
+		void NoteKeyWait();
+
+		/**
+		 * Goes back to the newest checkpoint at least `seconds` of emulated time ago, or the oldest
+		 * one. Returns false if there's none.
+		 */
+		bool Rewind(double seconds);
+		/**
+		 * Goes back to right after the instruction before the last one. Returns false if that's
+		 * older than the buffer.
+		 */
+		bool StepBack();
+		/**
+		 * Goes back to right after the latest earlier instruction `stop` accepts, or to the oldest
+		 * checkpoint if there's none. `stop` sees the machine as it was then. Returns false if there
+		 * was no history to go back into or a replay diverged, the machine is where it stopped then.
+		 */
+		bool ContinueBack(const std::function<bool()>& stop);
+		/**
+		 * Emulated seconds between the oldest and the newest checkpoint.
+		 */
+		double GetSpan();
+	};
+} // namespace casioemu
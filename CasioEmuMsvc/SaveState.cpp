@@ -0,0 +1,82 @@
+﻿#include "SaveState.hpp"
+
+#include <cstring>
+#include <sstream>
+
+namespace casioemu {
+	static const char state_magic[4] = {'C', 'E', 'S', 'S'};
+
+	/**
+	 * Build options that change what the sections contain.
+	 */
+	static const uint32_t state_flags =
+#ifdef DBG
+		1
+#else
+		0
+#endif
+		;
+
+	StateWriter::StateWriter(std::ostream& _os, uint64_t model_hash) : os(_os) {
+		os.write(state_magic, sizeof(state_magic));
+		Binary::WriteAll(os, state_version, state_flags, model_hash);
+	}
+
+	void StateWriter::WriteSection(const char* tag, const std::string& contents) {
+		os.write(tag, 4);
+		Binary::Write(os, (uint64_t)contents.size());
+		os.write(contents.data(), contents.size());
+	}
+
+	void StateWriter::End() {
+		WriteSection("END ", {});
+	}
+
+	bool StateReader::Open(std::istream& is, uint64_t model_hash) {
+		// In one go, an image section alone can be 512 KiB.
+		std::ostringstream contents;
+		contents << is.rdbuf();
+		data = std::move(contents).str();
+		sections.clear();
+
+		MemoryBuffer buffer(data.data(), data.size());
+		std::istream header(&buffer);
+		char magic[4]{};
+		uint32_t version = 0, flags = 0;
+		uint64_t hash = 0;
+		header.read(magic, sizeof(magic));
+		Binary::ReadAll(header, version, flags, hash);
+		if (header.fail() || memcmp(magic, state_magic, sizeof(magic))) {
+			error = "not a save state";
+			return false;
+		}
+		if (version != state_version || flags != state_flags) {
+			error = "made by another version of the emulator";
+			return false;
+		}
+		if (hash != model_hash) {
+			error = "made with another model or ROM";
+			return false;
+		}
+
+		size_t offset = buffer.Consumed();
+		while (true) {
+			if (data.size() - offset < 4 + sizeof(uint64_t)) {
+				error = "cut short";
+				return false;
+			}
+			std::string tag = data.substr(offset, 4);
+			uint64_t size;
+			memcpy(&size, data.data() + offset + 4, sizeof(size));
+			offset += 4 + sizeof(size);
+			if (size > data.size() - offset) {
+				error = "cut short";
+				return false;
+			}
+			if (tag == "END ")
+				return true;
+			sections[tag] = {offset, (size_t)size};
+			offset += size;
+		}
+	}
+} // namespace casioemu
@@ -0,0 +1,112 @@
+﻿#pragma once
+#include "Config.hpp"
+#include "Binary.h"
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+namespace casioemu {
+	/**
+	 * Save state container, see Emulator::SaveState. All values are written with Binary:
+	 *
+	 *   magic "CESS", format version, build flags, model hash (Emulator::GetModelHash)
+	 *   sections: 4 character tag, byte length, contents
+	 *   "END " section, empty
+	 *
+	 * A state only loads into the same model built the same way, anything else is rejected before
+	 * the machine is touched. Bump `state_version` whenever a section changes its layout.
+	 */
+	static const uint32_t state_version = 4;
+
+	class StateWriter {
+		std::ostream& os;
+		std::ostringstream scratch;
+
+		void WriteSection(const char* tag, const std::string& contents);
+
+	public:
+		StateWriter(std::ostream& os, uint64_t model_hash);
+
+		/**
+		 * Writes the section `tag`, `write` gets the stream for its contents.
+		 */
+		template <typename F>
+		void Section(const char* tag, F write) {
+			scratch.str({});
+			scratch.clear();
+			write((std::ostream&)scratch);
+			WriteSection(tag, scratch.str());
+		}
+		void End();
+	};
+
+	class StateReader {
+		std::string data;
+		struct Entry {
+			size_t offset, size;
+		};
+		std::map<std::string, Entry> sections;
+		std::string error;
+
+		struct MemoryBuffer : std::streambuf {
+			MemoryBuffer(const char* begin, size_t size) {
+				char* p = const_cast<char*>(begin);
+				setg(p, p, p + size);
+			}
+			size_t Consumed() {
+				return gptr() - eback();
+			}
+		};
+
+	public:
+		/**
+		 * Reads the whole state and checks the header and the section table. Returns false with
+		 * Error set if it's not a state of this model and build or it's cut short.
+		 */
+		bool Open(std::istream& is, uint64_t model_hash);
+
+		/**
+		 * Runs `read` on the contents of the section `tag`. Returns false with Error set if the
+		 * section is missing or `read` didn't consume exactly its contents.
+		 */
+		template <typename F>
+		bool Section(const char* tag, F read) {
+			auto entry = sections.find(tag);
+			if (entry == sections.end()) {
+				error = std::string("missing section ") + tag;
+				return false;
+			}
+			MemoryBuffer buffer(data.data() + entry->second.offset, entry->second.size);
+			std::istream is(&buffer);
+			read(is);
+			if (is.fail() || buffer.Consumed() != entry->second.size) {
+				error = std::string("damaged section ") + tag;
+				return false;
+			}
+			return true;
+		}
+		/**
+		 * Checks that the section `tag` is there and, unless `size` is npos, that it's `size` bytes
+		 * long, without reading it. Returns false with Error set otherwise.
+		 */
+		bool Expect(const char* tag, size_t size = std::string::npos) {
+			auto entry = sections.find(tag);
+			if (entry == sections.end()) {
+				error = std::string("missing section ") + tag;
+				return false;
+			}
+			if (size != std::string::npos && entry->second.size != size) {
+				error = std::string("damaged section ") + tag;
+				return false;
+			}
+			return true;
+		}
+		const std::string& Error() {
+			return error;
+		}
+	};
+} // namespace casioemu
@@ -2,7 +2,12 @@
 #include "Ui.hpp"
 #include "imgui_impl_sdl2.h"
 
+#include "BatchRunner.hpp"
 #include "Emulator.hpp"
+#include "FramePacer.hpp"
+#include "HeadlessRunner.hpp"
+#include "Hooks.h"
+#include "LcdKernel.hpp"
 #include "Logger.hpp"
 #include "SDL_events.h"
 #include "SDL_keyboard.h"
@@ -65,9 +70,13 @@ int main(int argc, char* argv[]) {
 		else
 			logger::Info("[argv][Info] #%i: key '%s' already set\n", ix, key.c_str());
 	}
-	bool headless = argv_map.find("headless") != argv_map.end();
+	bool batch = argv_map.find("batch") != argv_map.end();
+	bool headless = batch || argv_map.find("headless") != argv_map.end();
 
-	int sdlFlags = SDL_INIT_VIDEO | SDL_INIT_TIMER;
+	if (argv_map.find("lcd_benchmark") != argv_map.end())
+		return LcdRunBenchmark();
+
+	int sdlFlags = headless ? SDL_INIT_TIMER : SDL_INIT_VIDEO | SDL_INIT_TIMER;
 	if (SDL_Init(sdlFlags) != 0)
 		PANIC("SDL_Init failed: %s\n", SDL_GetError());
 
@@ -75,32 +84,42 @@ int main(int argc, char* argv[]) {
 	if (IMG_Init(imgFlags) != imgFlags)
 		PANIC("IMG_Init failed: %s\n", IMG_GetError());
 
+	if (batch)
+		return BatchRun(argv_map);
+
 	if (argv_map["model"].empty()) {
+		if (headless)
+			PANIC("headless needs a model argument\n");
 		auto s = sui_loop();
 		argv_map["model"] = std::move(s);
 		if (argv_map["model"].empty())
 			return -1;
 	}
 
-	Emulator emulator(argv_map);
+	// A headless script runs the machine only while it waits, see HeadlessRunner. Turbo takes
+	// the host clock out of the EMUCLK tick and the TI key wait, as for batch jobs.
+	bool scripted = headless && argv_map.find("input") != argv_map.end();
+	if (scripted)
+		argv_map["turbo"];
+	Emulator emulator(argv_map, scripted);
 	m_emu = &emulator;
 
+	if (headless) {
+		HeadlessRunner runner(emulator);
+		int result = runner.Run();
+		emulator.Shutdown();
+		return result;
+	}
+
 	// static std::atomic<bool> running(true);
 
 	bool guiCreated = false;
-	auto frame_event = SDL_RegisterEvents(1);
-	bool busy = false;
-	std::thread t3([&]() {
-		SDL_Event se{};
-		se.type = frame_event;
-		se.user.windowID = SDL_GetWindowID(emulator.window);
-		while (1) {
-			if (!busy)
-				SDL_PushEvent(&se);
-			SDL_Delay(24);
-		}
+	FramePacer pacer;
+	auto frame_pacing = argv_map.find("frame_pacing");
+	pacer.Setup(frame_pacing == argv_map.end() ? "" : frame_pacing->second, emulator.window);
+	SetupHook(emulator.hooks.on_screen_changed, [&](Emulator&) {
+		pacer.RequestFrame();
 	});
-	t3.detach();
 #ifdef DBG
 	test_gui(&guiCreated, emulator.window, emulator.renderer);
 #endif
@@ -112,60 +131,12 @@ int main(int argc, char* argv[]) {
 
 	SDL_ShowWindow(emulator.window);
 
-	while (emulator.Running()) {
-		SDL_Event event{};
-		busy = false;
-		if (!SDL_PollEvent(&event))
-			continue;
-		busy = true;
-		if (event.type == frame_event) {
-			SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-			SDL_RenderClear(renderer);
-			if (bg_txt) {
-				int w, h;
-				SDL_GetWindowSize(window, &w, &h);
-				int bg_w, bg_h;
-				SDL_QueryTexture(bg_txt, NULL, NULL, &bg_w, &bg_h);
-
-				float window_aspect = (float)w / h;
-				float bg_aspect = (float)bg_w / bg_h;
-
-				SDL_Rect dst_rect;
-				if (window_aspect > bg_aspect) {
-					dst_rect.w = w;
-					dst_rect.h = (int)(w / bg_aspect);
-					dst_rect.x = 0;
-					dst_rect.y = (h - dst_rect.h) / 2;
-				}
-				else {
-					dst_rect.h = h;
-					dst_rect.w = (int)(h * bg_aspect);
-					dst_rect.x = (w - dst_rect.w) / 2;
-					dst_rect.y = 0;
-				}
-
-				SDL_RenderCopy(renderer, bg_txt, NULL, &dst_rect);
-			}
-			SDL_SetRenderDrawColor(renderer, 0, 0, 0, 20);
-			SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-			SDL_RenderFillRect(renderer, 0);
-#ifdef SINGLE_WINDOW
-			emulator.Frame();
-			gui_loop();
-			SDL_RenderPresent(emulator.renderer);
-#else
-			gui_loop();
-			emulator.Frame();
-			SDL_RenderPresent(emulator.renderer);
-#endif
-
-			while (SDL_PollEvent(&event)) {
-				if (event.type != frame_event)
-					goto hld;
-			}
-			continue;
-		}
-	hld:
+	auto handle_event = [&](SDL_Event& event) {
+		if (pacer.IsWakeEvent(event))
+			return;
+		pacer.RequestFrame();
+		if (guiCreated)
+			gui_invalidate();
 		switch (event.type) {
 		case SDL_WINDOWEVENT:
 			switch (event.window.event) {
@@ -201,6 +172,65 @@ int main(int argc, char* argv[]) {
 			emulator.UIEvent(event);
 			break;
 		}
+	};
+
+	while (emulator.Running()) {
+		// Sleep until there is input, the next frame is due or the debugger wants a refresh.
+		int timeout = pacer.GetTimeout();
+		int gui_timeout = guiCreated ? gui_refresh_timeout() : -1;
+		if (gui_timeout >= 0 && (timeout < 0 || gui_timeout < timeout))
+			timeout = gui_timeout;
+		SDL_Event event{};
+		if (SDL_WaitEventTimeout(&event, timeout)) {
+			do
+				handle_event(event);
+			while (SDL_PollEvent(&event));
+		}
+		if (guiCreated && gui_refresh_timeout() == 0)
+			pacer.RequestFrame();
+		if (!pacer.FrameDue())
+			continue;
+
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+		SDL_RenderClear(renderer);
+		if (bg_txt) {
+			int w, h;
+			SDL_GetWindowSize(window, &w, &h);
+			int bg_w, bg_h;
+			SDL_QueryTexture(bg_txt, NULL, NULL, &bg_w, &bg_h);
+
+			float window_aspect = (float)w / h;
+			float bg_aspect = (float)bg_w / bg_h;
+
+			SDL_Rect dst_rect;
+			if (window_aspect > bg_aspect) {
+				dst_rect.w = w;
+				dst_rect.h = (int)(w / bg_aspect);
+				dst_rect.x = 0;
+				dst_rect.y = (h - dst_rect.h) / 2;
+			}
+			else {
+				dst_rect.h = h;
+				dst_rect.w = (int)(h * bg_aspect);
+				dst_rect.x = (w - dst_rect.w) / 2;
+				dst_rect.y = 0;
+			}
+
+			SDL_RenderCopy(renderer, bg_txt, NULL, &dst_rect);
+		}
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 20);
+		SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+		SDL_RenderFillRect(renderer, 0);
+#ifdef SINGLE_WINDOW
+		emulator.Frame();
+		gui_loop();
+		SDL_RenderPresent(emulator.renderer);
+#else
+		gui_loop();
+		emulator.Frame();
+		SDL_RenderPresent(emulator.renderer);
+#endif
+		pacer.FrameDone();
 	}
 	return 0;
 };
\ No newline at end of file